@@ -0,0 +1,496 @@
+// Headless micro-benchmarks for the DSP and maths hot paths.
+//
+//   bench [--filter text] [--min-time seconds] [--json path|-] [--fail-on-alloc]
+//
+// Each benchmark is calibrated to run for at least --min-time per repeat and
+// reports the median of its repeats as ns/op, plus items/s and the number of
+// heap allocations per op. --json writes the same results for regression
+// tracking; "-" writes them to stdout instead of the table. --fail-on-alloc
+// exits with failure if any benchmark run allocated, for guarding steady-state
+// loops such as frame/cpu_loop in CI.
+//
+// fft/accuracy_<size> entries are not timed: they compare FFT::magnitudes with
+// the O(n^2) dft_magnitudes on noise and fail the run if the largest error,
+// relative to the largest magnitude, exceeds max_fft_error.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/alloc_counter.h"
+#include "../src/audio_features.h"
+#include "../src/band_map.h"
+#include "../src/bar_layout.h"
+#include "../src/bar_dynamics.h"
+#include "../src/fft.h"
+#include "../src/frame_arena.h"
+#include "../src/maths.h"
+#include "../src/spectrum.h"
+#include "../src/stft.h"
+#include "../src/utils.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace bench {
+	using namespace maths;
+
+	// Stop the optimiser from discarding a result or hoisting work out of the loop
+	template<typename T>
+	inline void keep(const T& value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+		const volatile char sink = *(const volatile char*)&value;
+		(void)sink;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r"(&value) : "memory");
+#endif
+	}
+
+	struct Benchmark {
+		std::string name;
+		double items_per_op;	// For throughput, e.g. samples per FFT
+		const char* unit;
+		std::function<void(long long)> run;	// Runs the op n times
+	};
+
+	struct Result {
+		std::string name;
+		long long ops;
+		double ns_per_op;
+		double items_per_second;
+		const char* unit;
+		double allocs_per_op;
+	};
+
+	typedef std::chrono::steady_clock clock;
+
+	static double seconds(long long ops, const std::function<void(long long)>& run) {
+		clock::time_point start = clock::now();
+		run(ops);
+		return std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	static Result measure(const Benchmark& b, double min_time) {
+		const int repeats = 5;
+
+		// Warm up, then grow the batch until one repeat takes min_time
+		b.run(1);
+		long long ops = 1;
+		for (;;) {
+			double t = seconds(ops, b.run);
+			if (t >= min_time || ops >= (1LL << 40))
+				break;
+			double scale = t > 0.0 ? min_time / t * 1.2 : 100.0;
+			ops = std::max(ops + 1, (long long)(ops * std::min(scale, 100.0)));
+		}
+
+		std::vector<double> times(repeats);
+		unsigned long long allocs_before = utils::heap_allocations();
+		for (int i = 0; i < repeats; i++)
+			times[i] = seconds(ops, b.run);
+		unsigned long long allocs = utils::heap_allocations() - allocs_before;
+
+		std::sort(times.begin(), times.end());
+		double ns_per_op = times[repeats / 2] * 1e9 / (double)ops;
+
+		Result r;
+		r.name = b.name;
+		r.ops = ops;
+		r.ns_per_op = ns_per_op;
+		r.items_per_second = b.items_per_op * 1e9 / ns_per_op;
+		r.unit = b.unit;
+		r.allocs_per_op = (double)allocs / ((double)ops * repeats);
+		return r;
+	}
+
+	struct Accuracy {
+		std::string name;
+		double max_error;		// Largest absolute difference over all bins
+		double relative_error;	// max_error over the largest reference magnitude
+	};
+
+	// Single precision butterflies accumulate around log2(size) roundings per bin
+	const double max_fft_error = 1e-5;
+
+	// The reference costs size^2 / 2 terms, so larger sizes are left out
+	const int max_accuracy_size = 4096;
+
+	static void fill_noise(float* out, int n, unsigned int seed) {
+		for (int i = 0; i < n; i++) {
+			seed = seed * 1664525u + 1013904223u;
+			out[i] = (float)(seed >> 8) * (1.f / 16777216.f);
+		}
+	}
+
+	// Same configuration as main.cpp's defaults, fixed at compile time
+	using Layout = BarLayout<2048, 512, 800, 600>;
+
+	const int fft_samples = Layout::fft_samples;
+	const int fft_size = fft_samples * 2;
+	const int hop_size = 512;
+	const int num_bins = Layout::num_bins;
+	const float sample_rate = 44100.f;
+	const float fft_scale = 5.f * 800.f;
+
+	// The layout tables must match what the runtime setup computes
+	static_assert(Layout::edges[0] == 0 && Layout::edges[num_bins] == fft_samples, "edges must span the spectrum");
+	static_assert(Layout::edges[1] == fft_samples / num_bins, "linear bands must be fft_samples / num_bins wide");
+	static_assert(Layout::bin_height == 600.f / 512.f, "bin_height must split the height between the bars");
+	static_assert(Layout::centres[0].x == 400.f && Layout::centres[0].y == Layout::bin_height * 0.5f, "first bar must sit at the bottom");
+	static_assert(Layout::centres[num_bins - 1].y == 600.f - Layout::bin_height * 0.5f, "last bar must sit at the top");
+	static_assert(Layout::projection[0][0] == 2.f / 800.f && Layout::projection[1][1] == 2.f / 600.f, "projection must map the resolution to clip space");
+	static_assert(Layout::projection[3][0] == -1.f && Layout::projection[3][1] == -1.f, "projection must put the origin in the bottom left");
+
+	static void add_bins(std::vector<Benchmark>& list) {
+		struct State {
+			std::vector<float> magnitudes = std::vector<float>(fft_samples);
+			std::vector<float> scratch = std::vector<float>(fft_samples);
+			std::vector<float> bins = std::vector<float>(num_bins);
+			std::vector<float> oldbins = std::vector<float>(num_bins);
+		};
+		auto state = std::make_shared<State>();
+		fill_noise(state->magnitudes.data(), fft_samples, 1);
+
+		// The original bin-averaging loop; it rescales its input in place, so refresh it each op
+		list.push_back({ "bins/update_bins", (double)fft_samples, "bins", [state](long long n) {
+			for (long long i = 0; i < n; i++) {
+				memcpy(state->scratch.data(), state->magnitudes.data(), fft_samples * sizeof(float));
+				dsp::update_bins(state->scratch.data(), fft_samples, state->bins.data(), state->oldbins.data(), num_bins, fft_scale);
+				keep(state->bins[0]);
+			}
+		} });
+
+		// Linear bands from the compile-time layout, as a fixed configuration would build them
+		auto linear = std::make_shared<dsp::BinKernel>(dsp::BandMap{ Layout::edges.data(), fft_samples, num_bins, sample_rate }, fft_scale);
+		list.push_back({ std::string("bins/kernel_linear_") + linear->isa, (double)fft_samples, "bins", [state, linear](long long n) {
+			for (long long i = 0; i < n; i++) {
+				linear->process(state->magnitudes.data(), state->bins.data(), state->oldbins.data());
+				keep(state->bins[0]);
+			}
+		} });
+
+		auto log = std::make_shared<dsp::BinKernel>(dsp::BandMap{ dsp::BandScale::log, fft_samples, num_bins, sample_rate }, fft_scale);
+		list.push_back({ std::string("bins/kernel_log_") + log->isa, (double)fft_samples, "bins", [state, log](long long n) {
+			for (long long i = 0; i < n; i++) {
+				log->process(state->magnitudes.data(), state->bins.data(), state->oldbins.data());
+				keep(state->bins[0]);
+			}
+		} });
+
+		// What the frame loop and the cache builders call
+		list.push_back({ std::string("bins/levels_log_") + log->isa, (double)fft_samples, "bins", [state, log](long long n) {
+			for (long long i = 0; i < n; i++) {
+				log->levels(state->magnitudes.data(), state->bins.data());
+				keep(state->bins[0]);
+			}
+		} });
+	}
+
+	static void add_maths(std::vector<Benchmark>& list) {
+		const int count = 1024;
+		const mat4 m = scale_rotate_translate(vec3{ 2.f, 3.f, 1.f }, vec3{ 10.f, 20.f, 30.f }, vec3{ 5.f, 6.f, 7.f });
+
+		auto points = std::make_shared<std::vector<vec4>>(count);
+		auto result = std::make_shared<std::vector<vec4>>(count);
+		for (int i = 0; i < count; i++)
+			(*points)[i] = vec4{ (float)i, (float)(i * 2), (float)(i * 3), 1.f };
+
+		// Chained through a pure rotation so each op depends on the last and values stay bounded
+		const mat4 r = rotate(vec3{ 10.f, 20.f, 30.f });
+
+		list.push_back({ "maths/mult_mat4_vec4", 1.0, "ops", [r, points](long long n) {
+			vec4 v = (*points)[1];
+			for (long long i = 0; i < n; i++) {
+				v = mult(r, v);
+				keep(v);
+			}
+		} });
+
+		list.push_back({ "maths/mult_mat4_mat4", 1.0, "ops", [r, m](long long n) {
+			mat4 a = m;
+			for (long long i = 0; i < n; i++) {
+				a = mult(a, r);
+				keep(a);
+			}
+		} });
+
+		list.push_back({ "maths/mult_batch_1024", (double)count, "vec4", [m, points, result](long long n) {
+			for (long long i = 0; i < n; i++) {
+				mult(m, points->data(), result->data(), count);
+				keep((*result)[0]);
+			}
+		} });
+
+		// One model matrix per bar, as the renderer used to build them
+		auto models = std::make_shared<std::vector<mat4>>(num_bins);
+		list.push_back({ "maths/gen_model_matrix_2d", (double)num_bins, "bars", [models](long long n) {
+			for (long long i = 0; i < n; i++) {
+				for (int b = 0; b < num_bins; b++)
+					(*models)[b] = utils::gen_model_matrix(vec2{ 1.f, (float)b }, vec2{ (float)b * 2.f, 300.f });
+				keep((*models)[0]);
+			}
+		} });
+
+		list.push_back({ "maths/gen_model_matrix_3d", (double)num_bins, "bars", [models](long long n) {
+			for (long long i = 0; i < n; i++) {
+				for (int b = 0; b < num_bins; b++)
+					(*models)[b] = utils::gen_model_matrix(vec3{ 1.f, (float)b, 1.f }, vec3{ (float)b * 2.f, 300.f, 0.f }, (float)b);
+				keep((*models)[0]);
+			}
+		} });
+
+		// Bar colour from its level, quiet to loud
+		auto levels = std::make_shared<std::vector<float>>(num_bins);
+		auto colours = std::make_shared<std::vector<vec4>>(num_bins);
+		fill_noise(levels->data(), num_bins, 2);
+		list.push_back({ "maths/lerp_colour", (double)num_bins, "bars", [levels, colours](long long n) {
+			for (long long i = 0; i < n; i++) {
+				for (int b = 0; b < num_bins; b++)
+					(*colours)[b] = lerp(utils::colour::red, utils::colour::green, (*levels)[b]);
+				keep((*colours)[0]);
+			}
+		} });
+	}
+
+	static void add_fft(std::vector<Benchmark>& list) {
+		for (int size = dsp::FFT::min_size; size <= dsp::FFT::max_size; size *= 2) {
+			auto fft = std::make_shared<dsp::FFT>(size);
+			auto samples = std::make_shared<std::vector<float>>(size);
+			auto out = std::make_shared<std::vector<float>>(size / 2);
+			fill_noise(samples->data(), size, 3);
+
+			list.push_back({ "fft/magnitudes_" + std::to_string(size), (double)size, "samples", [fft, samples, out](long long n) {
+				for (long long i = 0; i < n; i++) {
+					fft->magnitudes(samples->data(), out->data());
+					keep((*out)[0]);
+				}
+			} });
+		}
+
+		// A hop's worth of samples per op, consuming frames as the render loop would
+		auto stft = std::make_shared<dsp::STFT>(fft_size, hop_size, sample_rate);
+		auto samples = std::make_shared<std::vector<float>>(hop_size);
+		fill_noise(samples->data(), hop_size, 4);
+		list.push_back({ "fft/stft_hop_" + std::to_string(hop_size), (double)hop_size, "samples", [stft, samples](long long n) {
+			for (long long i = 0; i < n; i++) {
+				stft->push(samples->data(), hop_size);
+				while (dsp::SpectrumFrame* frame = stft->front()) {
+					keep(frame->magnitudes[0]);
+					stft->pop();
+				}
+			}
+		} });
+	}
+
+	static std::vector<Accuracy> fft_accuracy(const char* filter) {
+		std::vector<Accuracy> results;
+		for (int size = dsp::FFT::min_size; size <= max_accuracy_size; size *= 2) {
+			const std::string name = "fft/accuracy_" + std::to_string(size);
+			if (!strstr(name.c_str(), filter))
+				continue;
+
+			dsp::FFT fft{ size };
+			std::vector<float> samples(size);
+			std::vector<float> fast(size / 2);
+			std::vector<float> reference(size / 2);
+			fill_noise(samples.data(), size, 6);
+
+			fft.magnitudes(samples.data(), fast.data());
+			dsp::dft_magnitudes(samples.data(), size, reference.data());
+
+			Accuracy a{ name, 0.0, 0.0 };
+			double peak = 0.0;
+			for (int k = 0; k < size / 2; k++) {
+				a.max_error = std::max(a.max_error, (double)fabsf(fast[k] - reference[k]));
+				peak = std::max(peak, (double)reference[k]);
+			}
+			a.relative_error = peak > 0.0 ? a.max_error / peak : a.max_error;
+			results.push_back(a);
+		}
+		return results;
+	}
+
+	static void add_features(std::vector<Benchmark>& list) {
+		// One analysis hop per op, draining events and frames as the render loop would
+		auto features = std::make_shared<dsp::FeatureAnalyser>(sample_rate);
+		const int hop = features->settings.hop;
+		auto samples = std::make_shared<std::vector<float>>(hop);
+		fill_noise(samples->data(), hop, 5);
+		list.push_back({ "features/push_hop_" + std::to_string(hop), (double)hop, "samples", [features, samples, hop](long long n) {
+			dsp::FeatureEvent event;
+			dsp::FeatureFrame frame;
+			for (long long i = 0; i < n; i++) {
+				features->push(samples->data(), hop);
+				while (features->poll(1e30, event))
+					keep(event.time);
+				features->frame_at(1e30, frame);
+				keep(frame.flux);
+			}
+		} });
+	}
+
+	static void add_frame(std::vector<Benchmark>& list) {
+		// The CPU side of one 60 Hz frame of main.cpp's live path: decoded audio into the
+		// STFT and feature analyser, the dynamics steps, overlays and per-frame arena data
+		struct State {
+			dsp::BandMap map{ dsp::BandScale::log, fft_samples, num_bins, sample_rate };
+			dsp::BinKernel kernel{ map, fft_scale };
+			dsp::STFT stft{ fft_size, hop_size, sample_rate };
+			dsp::FeatureAnalyser features{ sample_rate };
+			dsp::BarDynamics dynamics{ num_bins, fft_scale };
+			utils::FrameArena arena{ 64 * 1024 };
+			std::vector<float> audio = std::vector<float>(735);
+			double time = 0.0;
+		};
+		auto state = std::make_shared<State>();
+		fill_noise(state->audio.data(), (int)state->audio.size(), 6);
+
+		list.push_back({ "frame/cpu_loop", (double)num_bins, "bins", [state](long long n) {
+			State& s = *state;
+			for (long long i = 0; i < n; i++) {
+				s.stft.push(s.audio.data(), (int)s.audio.size());
+				s.features.push(s.audio.data(), (int)s.audio.size());
+				s.time += 1.0 / 60.0;
+
+				utils::ArenaAllocator<float> floats{ s.arena };
+				utils::frame_vector<float> spectrum(s.stft.num_bins, 0.f, floats);
+				utils::frame_vector<float> levels(num_bins, 0.f, floats);
+				utils::frame_vector<float> bins(num_bins, 0.f, floats);
+				utils::frame_vector<float> peaks(num_bins, 0.f, floats);
+
+				dsp::FeatureEvent event;
+				while (s.features.poll(s.time, event))
+					keep(event.time);
+				dsp::FeatureFrame frame;
+				s.features.frame_at(s.time, frame);
+
+				while (s.dynamics.due(s.time)) {
+					s.stft.sample(s.dynamics.step_time(), spectrum.data());
+					s.kernel.levels(spectrum.data(), levels.data());
+					s.dynamics.step(levels.data());
+				}
+				s.dynamics.interpolate(s.time, bins.data(), peaks.data());
+
+				utils::frame_string overlay = utils::friendly_float(s.arena, frame.tempo, 5);
+				keep(overlay[0]);
+				keep(bins[0]);
+				s.arena.reset();
+			}
+		} });
+	}
+
+	static void write_json(FILE* file, const std::vector<Result>& results, const std::vector<Accuracy>& accuracy, double min_time) {
+		fprintf(file, "{\n  \"min_time\": %g,\n  \"benchmarks\": [\n", min_time);
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			fprintf(file, "    {\"name\": \"%s\", \"ops\": %lld, \"ns_per_op\": %.3f, \"items_per_second\": %.1f, \"unit\": \"%s\", \"allocs_per_op\": %.3f}%s\n",
+				r.name.c_str(), r.ops, r.ns_per_op, r.items_per_second, r.unit, r.allocs_per_op, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "  ],\n  \"accuracy\": [\n");
+		for (size_t i = 0; i < accuracy.size(); i++) {
+			const Accuracy& a = accuracy[i];
+			fprintf(file, "    {\"name\": \"%s\", \"max_error\": %.3g, \"relative_error\": %.3g}%s\n",
+				a.name.c_str(), a.max_error, a.relative_error, i + 1 < accuracy.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* filter = "";
+	const char* json = nullptr;
+	double min_time = 0.1;
+	bool fail_on_alloc = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+			min_time = std::max(0.001, atof(argv[++i]));
+		else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+			json = argv[++i];
+		else if (!strcmp(argv[i], "--fail-on-alloc"))
+			fail_on_alloc = true;
+		else {
+			fprintf(stderr, "usage: %s [--filter text] [--min-time seconds] [--json path|-] [--fail-on-alloc]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<bench::Benchmark> list;
+	bench::add_bins(list);
+	bench::add_maths(list);
+	bench::add_fft(list);
+	bench::add_features(list);
+	bench::add_frame(list);
+
+	const bool table = !json || strcmp(json, "-") != 0;
+	if (table)
+		printf("%-28s %14s %16s %12s\n", "benchmark", "ns/op", "throughput", "allocs/op");
+
+	std::vector<bench::Result> results;
+	for (const bench::Benchmark& b : list) {
+		if (!strstr(b.name.c_str(), filter))
+			continue;
+
+		bench::Result r = bench::measure(b, min_time);
+		results.push_back(r);
+
+		if (table) {
+			char throughput[64];
+			snprintf(throughput, sizeof(throughput), "%.1fM %s/s", r.items_per_second * 1e-6, r.unit);
+			printf("%-28s %14.2f %16s %12.3f\n", r.name.c_str(), r.ns_per_op, throughput, r.allocs_per_op);
+			fflush(stdout);
+		}
+	}
+
+	std::vector<bench::Accuracy> accuracy = bench::fft_accuracy(filter);
+	if (table && !accuracy.empty()) {
+		printf("\n%-28s %14s %16s\n", "accuracy vs DFT", "max error", "relative");
+		for (const bench::Accuracy& a : accuracy)
+			printf("%-28s %14.3g %16.3g\n", a.name.c_str(), a.max_error, a.relative_error);
+	}
+
+	if (json) {
+		FILE* file = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+		if (!file) {
+			fprintf(stderr, "Could not write %s\n", json);
+			return EXIT_FAILURE;
+		}
+		bench::write_json(file, results, accuracy, min_time);
+		if (file != stdout)
+			fclose(file);
+	}
+
+	bool inaccurate = false;
+	for (const bench::Accuracy& a : accuracy) {
+		if (a.relative_error > bench::max_fft_error) {
+			fprintf(stderr, "%s differs from the reference DFT by %.3g of the peak\n", a.name.c_str(), a.relative_error);
+			inaccurate = true;
+		}
+	}
+	if (inaccurate)
+		return EXIT_FAILURE;
+
+	if (fail_on_alloc) {
+		bool allocated = false;
+		for (const bench::Result& r : results) {
+			if (r.allocs_per_op > 0.0) {
+				fprintf(stderr, "%s allocates %.3f times per op\n", r.name.c_str(), r.allocs_per_op);
+				allocated = true;
+			}
+		}
+		if (allocated)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
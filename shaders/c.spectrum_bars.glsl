@@ -0,0 +1,125 @@
+#version 450
+
+// Band levels and bar dynamics for every bar in one work group.
+//
+// mode 0 runs one simulation step: the magnitudes interpolated between two
+// frames (dsp::STFT::sample), square-rooted, peak normalised and summed through
+// the band map (BinKernel::levels), then attack/release and peak hold/gravity
+// (BarDynamics::step). mode 1 blends the last two states into the bar and peak
+// instance buffers (BarDynamics::interpolate).
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 2) readonly buffer Frames { float frames[]; };
+
+// start[num_bars], count[num_bars], offset[num_bars]
+layout(std430, binding = 3) readonly buffer BandIndex { int band_index[]; };
+layout(std430, binding = 4) readonly buffer BandWeights { float band_weights[]; };
+
+// level[2][num_bars], peak[2][num_bars], hold[num_bars], velocity[num_bars]
+layout(std430, binding = 5) buffer State { float state[]; };
+
+layout(std430, binding = 6) writeonly buffer Bars { float bars[]; };
+layout(std430, binding = 7) writeonly buffer Peaks { float peaks[]; };
+
+uniform int mode;
+uniform int num_bars;
+uniform int fft_samples;
+uniform int current;
+
+// mode 0
+uniform int frame_a;
+uniform int frame_b;
+uniform float frame_t;
+uniform float attack_k;
+uniform float release_k;
+uniform float dt;
+uniform float peak_hold;
+uniform float peak_gravity;
+
+// mode 1
+uniform float blend;
+uniform float scale;
+uniform int bars_first;
+uniform int peaks_first;
+
+shared float roots[2048];
+shared float partial[256];
+
+void step() {
+	const int tid = int(gl_LocalInvocationID.x);
+	const int a = frame_a * fft_samples;
+	const int b = frame_b * fft_samples;
+
+	float max_v = 0.0;
+	for (int i = tid; i < fft_samples; i += 256) {
+		precise float m = frames[a + i] + (frames[b + i] - frames[a + i]) * frame_t;
+		roots[i] = sqrt(m);
+		max_v = max(max_v, roots[i]);
+	}
+
+	partial[tid] = max_v;
+	barrier();
+	for (int s = 128; s > 0; s >>= 1) {
+		if (tid < s)
+			partial[tid] = max(partial[tid], partial[tid + s]);
+		barrier();
+	}
+	const float norm = partial[0] > 0.0 ? 1.0 / partial[0] : 1.0;
+
+	const int next = 1 - current;
+	for (int i = tid; i < num_bars; i += 256) {
+		const int start = band_index[i];
+		const int count = band_index[num_bars + i];
+		const int offset = band_index[2 * num_bars + i];
+
+		precise float sum = 0.0;
+		for (int j = 0; j < count; j++)
+			sum += roots[start + j] * band_weights[offset + j];
+
+		precise float target = sum * norm;
+		float old = state[current * num_bars + i];
+		precise float level = old + (target - old) * (target > old ? attack_k : release_k);
+		state[next * num_bars + i] = level;
+
+		// Peaks catch the level, hold, then fall under gravity until they meet it again
+		float peak = state[(2 + current) * num_bars + i];
+		float hold = state[4 * num_bars + i];
+		float velocity = state[5 * num_bars + i];
+		if (level >= peak) {
+			peak = level;
+			hold = peak_hold;
+			velocity = 0.0;
+		}
+		else if (hold > 0.0) {
+			hold -= dt;
+		}
+		else {
+			velocity += peak_gravity * dt;
+			precise float fallen = peak - velocity * dt;
+			peak = max(level, fallen);
+		}
+		state[(2 + next) * num_bars + i] = peak;
+		state[4 * num_bars + i] = hold;
+		state[5 * num_bars + i] = velocity;
+	}
+}
+
+void output_bars() {
+	const int previous = 1 - current;
+	for (int i = int(gl_LocalInvocationID.x); i < num_bars; i += 256) {
+		float l0 = state[previous * num_bars + i], l1 = state[current * num_bars + i];
+		float p0 = state[(2 + previous) * num_bars + i], p1 = state[(2 + current) * num_bars + i];
+		precise float bar = (l0 + (l1 - l0) * blend) * scale;
+		precise float peak = (p0 + (p1 - p0) * blend) * scale;
+		bars[bars_first + i] = bar;
+		peaks[peaks_first + i] = peak;
+	}
+}
+
+void main() {
+	if (mode == 0)
+		step();
+	else
+		output_bars();
+}
@@ -0,0 +1,77 @@
+#version 450
+
+// One work group per PCM window: the windowed magnitude spectrum exactly as
+// dsp::FFT::magnitudes computes it. The even/odd samples are packed into a
+// size / 2 point complex FFT in shared memory, which is then unpacked into the
+// positive-frequency bins. precise keeps the driver from fusing multiplies and
+// adds the CPU does separately.
+
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer Windows { float windows[]; };
+
+// window[size], then twiddle_re, twiddle_im, unpack_re, unpack_im of size / 2 each
+layout(std430, binding = 1) readonly buffer Tables { float tables[]; };
+
+layout(std430, binding = 2) writeonly buffer Frames { float frames[]; };
+
+uniform int size;
+uniform int log2_half;
+uniform int first_slot;
+uniform int ring_frames;
+
+shared float s_re[2048];
+shared float s_im[2048];
+
+void main() {
+	const int n_half = size / 2;
+	const int tid = int(gl_LocalInvocationID.x);
+	const int group = int(gl_WorkGroupID.x);
+	const int input_base = group * size;
+	const int tw_re = size, tw_im = size + n_half, un_re = size + 2 * n_half, un_im = size + 3 * n_half;
+
+	// Pack even/odd samples as real/imaginary parts, in bit-reversed order
+	for (int n = tid; n < n_half; n += 256) {
+		int k = int(bitfieldReverse(uint(n)) >> uint(32 - log2_half));
+		s_re[k] = windows[input_base + 2 * n] * tables[2 * n];
+		s_im[k] = windows[input_base + 2 * n + 1] * tables[2 * n + 1];
+	}
+	barrier();
+
+	for (int h = 1; h < n_half; h <<= 1) {
+		for (int b = tid; b < n_half / 2; b += 256) {
+			int j = b & (h - 1);
+			int a = (b - j) * 2 + j;
+			float wr = tables[tw_re + h - 1 + j];
+			float wi = tables[tw_im + h - 1 + j];
+
+			precise float vr = s_re[a + h] * wr - s_im[a + h] * wi;
+			precise float vi = s_re[a + h] * wi + s_im[a + h] * wr;
+			float ur = s_re[a];
+			float ui = s_im[a];
+			s_re[a] = ur + vr;
+			s_im[a] = ui + vi;
+			s_re[a + h] = ur - vr;
+			s_im[a + h] = ui - vi;
+		}
+		barrier();
+	}
+
+	// Split the half-size result into even and odd spectra and recombine
+	const float scale = 2.0 / float(size);
+	const int output_base = ((first_slot + group) % ring_frames) * n_half;
+	for (int k = tid; k < n_half; k += 256) {
+		int nk = (n_half - k) & (n_half - 1);
+		float zr = s_re[k], zi = s_im[k];
+		float cr = s_re[nk], ci = -s_im[nk];
+
+		precise float er = 0.5 * (zr + cr);
+		precise float ei = 0.5 * (zi + ci);
+		precise float or_ = 0.5 * (zi - ci);
+		precise float oi = -0.5 * (zr - cr);
+
+		precise float xr = er + (tables[un_re + k] * or_ - tables[un_im + k] * oi);
+		precise float xi = ei + (tables[un_re + k] * oi + tables[un_im + k] * or_);
+		frames[output_base + k] = sqrt(xr * xr + xi * xi) * scale;
+	}
+}
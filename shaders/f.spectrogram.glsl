@@ -0,0 +1,22 @@
+#version 450
+
+// Columns are texture rows in a ring; scroll is the oldest row over history,
+// so the left edge starts there and the newest row lands on the right edge.
+
+in vec2 uv_out;
+
+out vec4 colour;
+
+uniform sampler2D history_texture;
+uniform float scroll;
+uniform float history;
+uniform float loudness_scale;
+uniform vec4 colour_quiet;
+uniform vec4 colour_loud;
+
+void main() {
+	// Snap to a row centre so neighbouring columns, and the ring seam, never blend
+	float row = min(floor(uv_out.x * history), history - 1.0);
+	float level = texture(history_texture, vec2(uv_out.y, fract(scroll + (row + 0.5) / history))).r;
+	colour = mix(colour_quiet, colour_loud, clamp(level / loudness_scale, 0.0, 1.0));
+}
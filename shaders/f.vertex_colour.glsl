@@ -0,0 +1,9 @@
+#version 450
+
+in vec4 colour_out;
+
+out vec4 colour;
+
+void main() {
+	colour = colour_out;
+}
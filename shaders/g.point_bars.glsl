@@ -0,0 +1,32 @@
+#version 450
+
+// Expands each bar's point into the same quad v.instanced_bars.glsl places:
+// centred on bin_pos_x and the point's position, length wide, bin_height tall.
+
+layout(points) in;
+layout(triangle_strip, max_vertices = 4) out;
+
+in float length_geom[];
+in float loudness_geom[];
+
+uniform mat4 projection;
+uniform float bin_height;
+uniform float bin_pos_x;
+uniform vec4 colour_quiet;
+uniform vec4 colour_loud;
+
+out vec4 colour_out;
+
+void main() {
+	vec2 centre = vec2(bin_pos_x, gl_in[0].gl_Position.y);
+	vec2 half_size = vec2(length_geom[0], bin_height) * 0.5;
+	vec4 colour = mix(colour_quiet, colour_loud, loudness_geom[0]);
+
+	const vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, -1.0), vec2(1.0, 1.0));
+	for (int i = 0; i < 4; i++) {
+		gl_Position = projection * vec4(centre + corners[i] * half_size, 0.0, 1.0);
+		colour_out = colour;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in float bin_value;
+
+uniform mat4 projection;
+uniform float bin_height;
+uniform float bin_pos_x;
+uniform float loudness_scale;
+uniform vec4 colour_quiet;
+uniform vec4 colour_loud;
+
+out vec2 uv_out;
+out vec4 colour_out;
+
+void main() {
+	vec2 size = vec2(bin_value, bin_height);
+	vec2 centre = vec2(bin_pos_x, (bin_height * 0.5) + (gl_InstanceID * bin_height));
+
+	gl_Position = projection * vec4((position.xy * size) + centre, 0.0, 1.0);
+	colour_out = mix(colour_quiet, colour_loud, bin_value / loudness_scale);
+	uv_out = uv;
+}
@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) in float position;
+layout(location = 1) in float bar_length;
+layout(location = 2) in float loudness;
+
+out float length_geom;
+out float loudness_geom;
+
+void main() {
+	gl_Position = vec4(0.0, position, 0.0, 1.0);
+	length_geom = bar_length;
+	loudness_geom = loudness;
+}
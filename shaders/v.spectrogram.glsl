@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+
+uniform mat4 projection;
+
+// x, y, width, height
+uniform vec4 rect;
+
+out vec2 uv_out;
+
+void main() {
+	uv_out = position.xy + 0.5;
+	gl_Position = projection * vec4(rect.xy + uv_out * rect.zw, 0.0, 1.0);
+}
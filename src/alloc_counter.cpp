@@ -0,0 +1,35 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+// Per thread, so one thread's check is not tripped by another's allocations.
+// Plain data with a constant initialiser, so using it never allocates itself.
+static thread_local unsigned long long allocations = 0;
+
+unsigned long long utils::heap_allocations() {
+	return allocations;
+}
+
+void* operator new(size_t size) {
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	allocations++;
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace utils {
+	// Calls to the global operator new so far on the calling thread. alloc_counter.cpp
+	// replaces the global allocation functions to count them; link it into any
+	// program that checks a loop is allocation-free by comparing two readings.
+	// Other threads (decoding, cache building) never show up in the count.
+	unsigned long long heap_allocations();
+}
@@ -0,0 +1,28 @@
+#include "atomic_file.h"
+
+namespace utils {
+	AtomicFile::AtomicFile(const char* path) : file(nullptr), path(path), temp_path(std::string(path) + ".tmp") {
+		file = fopen(temp_path.c_str(), "wb");
+	}
+
+	AtomicFile::~AtomicFile() {
+		if (file)
+			commit(false);
+	}
+
+	bool AtomicFile::commit(bool ok) {
+		if (!file)
+			return false;
+		ok = (fclose(file) == 0) && ok;
+		file = nullptr;
+
+		// rename() will not replace an existing file on Windows
+		if (ok) {
+			remove(path.c_str());
+			ok = rename(temp_path.c_str(), path.c_str()) == 0;
+		}
+		if (!ok)
+			remove(temp_path.c_str());
+		return ok;
+	}
+}
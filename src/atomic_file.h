@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace utils {
+	// A file written through path + ".tmp" and only moved over path by commit(),
+	// so a crash or a failed write never leaves a truncated file behind. The
+	// temporary is removed if the file is destroyed without being committed.
+	class AtomicFile {
+	public:
+		explicit AtomicFile(const char* path);
+		~AtomicFile();
+
+		AtomicFile(const AtomicFile&) = delete;
+		AtomicFile& operator = (const AtomicFile&) = delete;
+
+		bool is_open() const { return file != nullptr; }
+
+		// Close the file and, if ok and it closed cleanly, replace path with it;
+		// otherwise remove it. True if path now holds what was written.
+		bool commit(bool ok);
+
+		FILE* file;
+
+	private:
+		std::string path;
+		std::string temp_path;
+	};
+}
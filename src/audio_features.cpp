@@ -0,0 +1,349 @@
+#include "audio_features.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsp {
+	// Spectral flux is taken over log(1 + compression * band energy)
+	static const float compression = 100.f;
+
+	// Tempo candidates are weighted towards this beat period by a log-Gaussian of this many octaves
+	static const double preferred_period = 0.5;
+	static const double prior_octaves = 1.4;
+
+	// Share of the autocorrelation at a tempo that its double must reach to be preferred
+	static const double octave_ratio = 0.85;
+
+	// Below this share of the envelope's energy the autocorrelation peak is not trusted as a tempo
+	static const float min_confidence = 0.5f;
+
+	// How quickly the beat period follows a changed tempo, per hop
+	static const double period_smoothing = 0.1;
+
+	static const double block_seconds = 0.1;
+	static const int momentary_blocks = 4;
+	static const int short_term_blocks = 30;
+
+	static float lufs(double mean_square) {
+		return mean_square > 1e-10 ? (float)(-0.691 + 10.0 * log10(mean_square)) : -100.f;
+	}
+
+	static float decibels(double mean_square) {
+		return mean_square > 1e-10 ? (float)(10.0 * log10(mean_square)) : -100.f;
+	}
+
+	void LatencyStats::add(double latency) {
+		count++;
+		total += latency;
+		max = std::max(max, latency);
+	}
+
+	FeatureAnalyser::FeatureAnalyser(float sample_rate, const FeatureSettings& settings) :
+		sample_rate(sample_rate),
+		settings(settings),
+		dropped_frames(0),
+		dropped_events(0),
+		hop_seconds(settings.hop / (double)sample_rate),
+		block_size(std::max(1, (int)std::lround(sample_rate * block_seconds))),
+		block_fill(0),
+		block_weighted(0.0),
+		block_plain(0.0),
+		weighted_blocks(short_term_blocks, 0.0),
+		plain_blocks(short_term_blocks, 0.0),
+		block_pos(0),
+		blocks_seen(0),
+		momentary(-100.f),
+		short_term(-100.f),
+		rms(-100.f),
+		stft(settings.fft_size, settings.hop, sample_rate, Window::hann, 8.6f, 4),
+		band_map(BandScale::log, settings.fft_size / 2, settings.num_bands, sample_rate),
+		bands(settings.num_bands, 0.f),
+		previous_bands(settings.num_bands, 0.f),
+		flux_history(std::max(1, (int)std::lround(settings.threshold_window / hop_seconds)), 0.f),
+		flux_pos(0),
+		flux_count(0),
+		flux_sum(0.0),
+		flux_before(0.f),
+		flux_candidate(0.f),
+		candidate_time(0.0),
+		last_onset(-1.0),
+		hops(0),
+		envelope_pos(0),
+		min_lag(std::max(1, (int)floor(60.0 / (settings.max_bpm * hop_seconds)))),
+		max_lag(std::max(2, (int)ceil(60.0 / (settings.min_bpm * hop_seconds)))),
+		energy(0.0),
+		tempo_decay(exp(-hop_seconds / std::max(0.1f, settings.tempo_memory))),
+		tempo(0.f),
+		confidence(0.f),
+		period(0.0),
+		next_beat(0.0),
+		last_beat(-1.0),
+		phase_re(0.0),
+		phase_im(0.0),
+		phase_decay(exp(-hop_seconds / std::max(0.1f, settings.phase_memory))),
+		phase_gain(1.0 - exp(-hop_seconds / std::max(0.01f, settings.phase_response))),
+		frames(settings.queue_frames),
+		events(settings.queue_events),
+		latest{ 0.0, -100.f, -100.f, -100.f, 0.f, 0.f },
+		has_latest(false)
+	{
+		// BS.1770 K-weighting, a high shelf then a high pass, designed for this sample rate
+		const double pi = 3.141592653589793;
+		double k = tan(pi * 1681.974450955533 / sample_rate);
+		double q = 0.7071752369554196;
+		double vh = pow(10.0, 3.999843853973347 / 20.0);
+		double vb = pow(vh, 0.4996667741545416);
+		double a0 = 1.0 + k / q + k * k;
+		shelf = Biquad{ (float)((vh + vb * k / q + k * k) / a0), (float)(2.0 * (k * k - vh) / a0), (float)((vh - vb * k / q + k * k) / a0),
+			(float)(2.0 * (k * k - 1.0) / a0), (float)((1.0 - k / q + k * k) / a0), 0.f, 0.f };
+
+		k = tan(pi * 38.13547087602444 / sample_rate);
+		q = 0.5003270373238773;
+		a0 = 1.0 + k / q + k * k;
+		high_pass = Biquad{ 1.f, -2.f, 1.f, (float)(2.0 * (k * k - 1.0) / a0), (float)((1.0 - k / q + k * k) / a0), 0.f, 0.f };
+
+		envelope.assign(max_lag + 1, 0.f);
+		autocorrelation.assign(max_lag + 2, 0.0);
+		tempo_prior.assign(max_lag + 2, 0.f);
+		for (int lag = min_lag; lag <= max_lag; lag++) {
+			double octaves = log2(lag * hop_seconds / preferred_period) / prior_octaves;
+			tempo_prior[lag] = (float)exp(-0.5 * octaves * octaves);
+		}
+	}
+
+	void FeatureAnalyser::push(const float* samples, int count) {
+		// At most one hop per piece, so the analysis STFT never holds more than one frame
+		while (count > 0) {
+			int n = std::min(count, settings.hop);
+			filter(samples, n);
+			stft.push(samples, n);
+			while (SpectrumFrame* frame = stft.front()) {
+				analyse(frame->magnitudes.data(), frame->time);
+				stft.pop();
+			}
+			samples += n;
+			count -= n;
+		}
+	}
+
+	void FeatureAnalyser::filter(const float* samples, int count) {
+		for (int i = 0; i < count; i++) {
+			float x = samples[i];
+			float w = high_pass.process(shelf.process(x));
+			block_weighted += (double)w * w;
+			block_plain += (double)x * x;
+
+			if (++block_fill < block_size)
+				continue;
+
+			weighted_blocks[block_pos] = block_weighted / block_size;
+			plain_blocks[block_pos] = block_plain / block_size;
+			block_pos = (block_pos + 1) % short_term_blocks;
+			blocks_seen++;
+			block_fill = 0;
+			block_weighted = 0.0;
+			block_plain = 0.0;
+
+			// Windows are short of their length until enough blocks have been seen
+			double weighted = 0.0, plain = 0.0;
+			const int m = std::min(blocks_seen, momentary_blocks), s = std::min(blocks_seen, short_term_blocks);
+			for (int b = 1; b <= s; b++) {
+				int j = (block_pos - b + short_term_blocks) % short_term_blocks;
+				weighted += weighted_blocks[j];
+				if (b <= m)
+					plain += plain_blocks[j];
+				if (b == m)
+					momentary = lufs(weighted / m);
+			}
+			short_term = lufs(weighted / s);
+			rms = decibels(plain / m);
+		}
+	}
+
+	void FeatureAnalyser::analyse(const float* magnitudes, double time) {
+		// Half-wave rectified rise of the log band energies
+		float flux = 0.f;
+		for (int b = 0; b < settings.num_bands; b++) {
+			const float* w = &band_map.weights[band_map.offset[b]];
+			const float* m = magnitudes + band_map.start[b];
+			float sum = 0.f;
+			for (int j = 0; j < band_map.count[b]; j++)
+				sum += w[j] * m[j];
+			bands[b] = log1pf(compression * sum);
+			flux += std::max(0.f, bands[b] - previous_bands[b]);
+		}
+		bands.swap(previous_bands);
+		flux = hops > 0 ? flux / settings.num_bands : 0.f;
+		hops++;
+
+		const int window = (int)flux_history.size();
+		flux_sum += flux - flux_history[flux_pos];
+		flux_history[flux_pos] = flux;
+		flux_pos = (flux_pos + 1) % window;
+		flux_count = std::min(flux_count + 1, window);
+		const float mean = (float)std::max(0.0, flux_sum / flux_count);
+		const float threshold = mean * settings.onset_threshold + settings.onset_delta;
+
+		const float envelope_value = std::max(0.f, flux - mean);
+		update_tempo(envelope_value);
+
+		// Beats up to the candidate's time go out before any onset there, so events stay in time order
+		track_beats(candidate_time, time);
+		align_phase(envelope_value, time);
+
+		// The previous hop is an onset if it peaks above the threshold
+		if (flux_candidate > threshold && flux_candidate > flux_before && flux_candidate >= flux &&
+			(last_onset < 0.0 || candidate_time - last_onset >= settings.min_onset_interval)) {
+			last_onset = candidate_time;
+			publish_event(FeatureEventType::onset, candidate_time, time, flux_candidate - threshold);
+		}
+
+		flux_before = flux_candidate;
+		flux_candidate = flux;
+		candidate_time = time;
+
+		FeatureFrame* frame = frames.back();
+		if (!frame) {
+			dropped_frames++;
+			return;
+		}
+		*frame = FeatureFrame{ time, rms, momentary, short_term, flux, tempo };
+		frames.publish();
+	}
+
+	void FeatureAnalyser::update_tempo(float value) {
+		const int size = (int)envelope.size();
+		envelope[envelope_pos] = value;
+
+		for (int lag = min_lag; lag <= max_lag; lag++) {
+			float past = envelope[(envelope_pos - lag + size) % size];
+			autocorrelation[lag] = autocorrelation[lag] * tempo_decay + (double)value * past;
+		}
+		energy = energy * tempo_decay + (double)value * value;
+		envelope_pos = (envelope_pos + 1) % size;
+
+		// Lags only mean something once the envelope has been through them twice
+		if (hops < 2 * max_lag || energy <= 0.0)
+			return;
+
+		int best = min_lag;
+		for (int lag = min_lag + 1; lag <= max_lag; lag++)
+			if (autocorrelation[lag] * tempo_prior[lag] > autocorrelation[best] * tempo_prior[best])
+				best = lag;
+
+		// A periodic envelope correlates as well at twice its period, so take the
+		// faster tempo while it is nearly as strong; the prior alone cannot tell them apart.
+		// The search stays below best so every step shortens it and the loop ends.
+		for (int half = best / 2; half >= min_lag; half = best / 2) {
+			int peak = half;
+			for (int lag = std::max(min_lag, half - 1); lag <= std::min(half + 1, best - 1); lag++)
+				if (autocorrelation[lag] > autocorrelation[peak])
+					peak = lag;
+			if (autocorrelation[peak] < octave_ratio * autocorrelation[best])
+				break;
+			best = peak;
+		}
+
+		confidence = (float)std::min(1.0, std::max(0.0, autocorrelation[best] / energy));
+		if (confidence < min_confidence) {
+			tempo = 0.f;
+			return;
+		}
+
+		// Parabolic peak between neighbouring lags
+		double lag = best;
+		if (best > min_lag && best < max_lag) {
+			double l = autocorrelation[best - 1], c = autocorrelation[best], r = autocorrelation[best + 1];
+			double d = l - 2.0 * c + r;
+			if (d < 0.0)
+				lag += std::max(-0.5, std::min(0.5, 0.5 * (l - r) / d));
+		}
+		tempo = (float)(60.0 / (lag * hop_seconds));
+	}
+
+	void FeatureAnalyser::track_beats(double time, double detected) {
+		// Without a tempo there is no grid; the next one starts afresh
+		if (tempo <= 0.f) {
+			period = 0.0;
+			phase_re = phase_im = 0.0;
+			return;
+		}
+
+		const double target = 60.0 / tempo;
+		if (period <= 0.0) {
+			// Start from the last onset, or from now without one
+			period = target;
+			next_beat = last_onset >= 0.0 ? last_onset : time;
+			while (next_beat <= time)
+				next_beat += period;
+			return;
+		}
+		period += (target - period) * period_smoothing;
+
+		while (next_beat <= time) {
+			publish_event(FeatureEventType::beat, next_beat, detected, confidence);
+			last_beat = next_beat;
+			next_beat += period;
+		}
+	}
+
+	void FeatureAnalyser::align_phase(float value, double time) {
+		if (period <= 0.0)
+			return;
+
+		// Envelope energy at its position on the beat grid; the phasor's angle is
+		// how far, as a share of the period, the energy sits off the predicted beats
+		const double tau = 6.283185307179586;
+		const double angle = tau * (time - (next_beat - period)) / period;
+		phase_re = phase_re * phase_decay + value * cos(angle);
+		phase_im = phase_im * phase_decay + value * sin(angle);
+		if (phase_re == 0.0 && phase_im == 0.0)
+			return;
+
+		// Shift the grid part of the way, never so far in a hop that it outruns time or
+		// jumps a beat, and the phasor with it so the offset is not corrected twice
+		const double limit = 0.5 * hop_seconds;
+		const double shift = std::max(-limit, std::min(limit, phase_gain * atan2(phase_im, phase_re) / tau * period));
+		if (next_beat + shift <= time)
+			return;
+		next_beat += shift;
+		const double c = cos(-tau * shift / period), s = sin(-tau * shift / period);
+		const double re = phase_re * c - phase_im * s;
+		phase_im = phase_re * s + phase_im * c;
+		phase_re = re;
+	}
+
+	void FeatureAnalyser::publish_event(FeatureEventType type, double event_time, double detected, float strength) {
+		FeatureEvent* event = events.back();
+		if (!event) {
+			dropped_events++;
+			return;
+		}
+		*event = FeatureEvent{ type, event_time, detected, strength };
+		events.publish();
+	}
+
+	bool FeatureAnalyser::poll(double time, FeatureEvent& event) {
+		FeatureEvent* next = events.front();
+		if (!next || next->time > time)
+			return false;
+
+		event = *next;
+		events.pop();
+		delivery_latency.add(time - event.time);
+		detection_latency.add(event.detected - event.time);
+		return true;
+	}
+
+	bool FeatureAnalyser::frame_at(double time, FeatureFrame& frame) {
+		while (FeatureFrame* next = frames.front()) {
+			if (next->time > time)
+				break;
+			latest = *next;
+			has_latest = true;
+			frames.pop();
+		}
+		frame = latest;
+		return has_latest;
+	}
+}
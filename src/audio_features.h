@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "band_map.h"
+#include "spsc_ring.h"
+#include "stft.h"
+
+namespace dsp {
+	struct FeatureSettings {
+		// Analysis STFT, independent of the display's: short hops keep onset latency down
+		int fft_size = 1024;
+		int hop = 256;
+
+		// Log bands the spectral flux is taken over
+		int num_bands = 32;
+
+		// An onset is a flux peak above threshold * (mean flux over threshold_window) + delta
+		float onset_threshold = 1.5f;
+		float onset_delta = 0.03f;
+		float threshold_window = 0.25f;
+		float min_onset_interval = 0.05f;
+
+		float min_bpm = 60.f;
+		float max_bpm = 200.f;
+
+		// Time constant of the tempo autocorrelation, in seconds
+		float tempo_memory = 4.f;
+
+		// Time constants of the beat phase estimate and of correcting the beat grid towards it, in seconds
+		float phase_memory = 2.f;
+		float phase_response = 0.5f;
+
+		// Frames and events buffered between the decoding thread and the consumer
+		int queue_frames = 512;
+		int queue_events = 256;
+	};
+
+	// Per-hop state published by the analyser
+	struct FeatureFrame {
+		double time;			// Stream time of the newest sample analysed
+		float rms;				// dBFS of the unweighted mean square over the momentary window
+		float momentary;		// LUFS, K-weighted over the last 400 ms
+		float short_term;		// LUFS, K-weighted over the last 3 s
+		float flux;				// Spectral flux of this hop
+		float tempo;			// BPM, 0 until a tempo has been found
+	};
+
+	enum class FeatureEventType {
+		onset,
+		beat
+	};
+
+	struct FeatureEvent {
+		FeatureEventType type;
+		double time;			// Stream time the event belongs to
+		double detected;		// Stream time of the newest sample when it was published
+		float strength;			// Onsets: flux over threshold. Beats: tempo confidence, 0-1
+	};
+
+	// Latency from an event's stream time to the moment it reached the consumer
+	struct LatencyStats {
+		LatencyStats() : count(0), total(0.0), max(0.0) {}
+
+		void add(double latency);
+		double mean() const { return count ? total / count : 0.0; }
+
+		unsigned int count;
+		double total;
+		double max;
+	};
+
+	// Loudness, onsets and beats from a mono stream, updated incrementally: each
+	// hop costs O(bands + tempo lags) against fixed-size histories, and nothing
+	// is allocated after construction. push() is the producer side, normally
+	// fed by an AnalysisTap on the decoding thread; since decoding runs ahead of
+	// playback, poll() can hand events to the consumer when the playback clock
+	// reaches them rather than when they were detected.
+	class FeatureAnalyser {
+	public:
+		FeatureAnalyser(float sample_rate, const FeatureSettings& settings = FeatureSettings());
+
+		// Producer: append mono samples
+		void push(const float* samples, int count);
+
+		// Consumer: next event at or before time, timed into the latency stats. False if none is due.
+		bool poll(double time, FeatureEvent& event);
+
+		// Consumer: the newest frame at or before time; false until the first one
+		bool frame_at(double time, FeatureFrame& frame);
+
+		float sample_rate;
+		FeatureSettings settings;
+
+		// Consumer side: audio time to delivery, and audio time to detection
+		LatencyStats delivery_latency;
+		LatencyStats detection_latency;
+
+		// Producer side: frames and events lost because the consumer stopped polling
+		std::atomic<unsigned int> dropped_frames;
+		std::atomic<unsigned int> dropped_events;
+
+	private:
+		struct Biquad {
+			float b0, b1, b2, a1, a2;
+			float z1, z2;
+
+			float process(float x) {
+				float y = b0 * x + z1;
+				z1 = b1 * x - a1 * y + z2;
+				z2 = b2 * x - a2 * y;
+				return y;
+			}
+		};
+
+		void filter(const float* samples, int count);
+		void analyse(const float* magnitudes, double time);
+		void update_tempo(float envelope);
+		// Emit the predicted beats up to time
+		void track_beats(double time, double detected);
+		void align_phase(float value, double time);
+		void publish_event(FeatureEventType type, double event_time, double detected, float strength);
+
+		double hop_seconds;
+
+		// Loudness: K-weighting, then 100 ms blocks of mean square in rings of 30 (3 s)
+		Biquad shelf;
+		Biquad high_pass;
+		int block_size;
+		int block_fill;
+		double block_weighted;
+		double block_plain;
+		std::vector<double> weighted_blocks;
+		std::vector<double> plain_blocks;
+		int block_pos;
+		int blocks_seen;
+		float momentary;
+		float short_term;
+		float rms;
+
+		// Onsets: log band energies and a ring of recent flux for the adaptive threshold
+		STFT stft;
+		BandMap band_map;
+		std::vector<float> bands;
+		std::vector<float> previous_bands;
+		std::vector<float> flux_history;
+		int flux_pos;
+		int flux_count;
+		double flux_sum;
+		// The previous hop is the peak candidate, judged against the hops either side of it
+		float flux_before;
+		float flux_candidate;
+		double candidate_time;
+		double last_onset;
+		long long hops;
+
+		// Tempo: onset envelope ring and exponentially forgetting autocorrelation per lag
+		std::vector<float> envelope;
+		int envelope_pos;
+		int min_lag;
+		int max_lag;
+		std::vector<double> autocorrelation;
+		std::vector<float> tempo_prior;
+		double energy;
+		double tempo_decay;
+		float tempo;
+		float confidence;
+
+		// Beats: prediction of the next beat, its grid pulled towards where the
+		// onset envelope's energy sits, measured as a decaying phasor
+		double period;
+		double next_beat;
+		double last_beat;
+		double phase_re;
+		double phase_im;
+		double phase_decay;
+		double phase_gain;
+
+		utils::SpscRing<FeatureFrame> frames;
+		utils::SpscRing<FeatureEvent> events;
+
+		// Consumer's copy of the newest frame handed out
+		FeatureFrame latest;
+		bool has_latest;
+	};
+}
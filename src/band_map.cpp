@@ -0,0 +1,153 @@
+#include "band_map.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsp {
+	// Frequency <-> warped scale, triangles are equally spaced in the warped domain
+	static float to_scale(BandScale scale, float hz) {
+		switch (scale) {
+		case BandScale::log: return logf(hz);
+		case BandScale::mel: return 2595.f * log10f(1.f + hz / 700.f);
+		case BandScale::erb: return 21.4f * log10f(1.f + 0.00437f * hz);
+		default: return hz;
+		}
+	}
+
+	static float from_scale(BandScale scale, float v) {
+		switch (scale) {
+		case BandScale::log: return expf(v);
+		case BandScale::mel: return 700.f * (powf(10.f, v / 2595.f) - 1.f);
+		case BandScale::erb: return (powf(10.f, v / 21.4f) - 1.f) / 0.00437f;
+		default: return v;
+		}
+	}
+
+	BandMap::BandMap(BandScale scale, int fft_samples, int num_bands, float sample_rate, float min_freq, float max_freq) :
+		scale(scale),
+		fft_samples(fft_samples),
+		num_bands(num_bands),
+		sample_rate(sample_rate)
+	{
+		start.reserve(num_bands);
+		count.reserve(num_bands);
+		offset.reserve(num_bands);
+
+		if (scale == BandScale::linear) {
+			std::vector<int> edges(num_bands + 1);
+			for (int i = 0; i <= num_bands; i++)
+				edges[i] = linear_band_edge(i, fft_samples, num_bands);
+			build_linear(edges.data());
+		}
+		else {
+			build_triangular(min_freq, max_freq);
+		}
+
+		build_groups();
+	}
+
+	BandMap::BandMap(const int* edges, int fft_samples, int num_bands, float sample_rate) :
+		scale(BandScale::linear),
+		fft_samples(fft_samples),
+		num_bands(num_bands),
+		sample_rate(sample_rate)
+	{
+		start.reserve(num_bands);
+		count.reserve(num_bands);
+		offset.reserve(num_bands);
+
+		build_linear(edges);
+		build_groups();
+	}
+
+	void BandMap::build_groups() {
+		group_width.assign((num_bands + 7) / 8, 0);
+		for (int i = 0; i < num_bands; i++)
+			group_width[i / 8] = std::max(group_width[i / 8], count[i]);
+	}
+
+	void BandMap::add_band(int first, const std::vector<float>& band_weights) {
+		start.push_back(first);
+		count.push_back((int)band_weights.size());
+		offset.push_back((int)weights.size());
+		weights.insert(weights.end(), band_weights.begin(), band_weights.end());
+	}
+
+	// Same grouping the bars have always used: band i averages bins [round(r * i), round(r * (i + 1)))
+	void BandMap::build_linear(const int* edges) {
+		std::vector<float> band;
+
+		for (int i = 0; i < num_bands; i++) {
+			int lower = std::min(edges[i], fft_samples);
+			int upper = std::min(edges[i + 1], fft_samples);
+			int n = std::max(0, upper - lower);
+
+			band.assign(n, n > 0 ? 1.f / (float)n : 0.f);
+			add_band(lower, band);
+		}
+	}
+
+	void BandMap::build_triangular(float min_freq, float max_freq) {
+		const float nyquist = sample_rate * 0.5f;
+		const float bin_hz = nyquist / (float)fft_samples;
+
+		if (max_freq <= 0.f || max_freq > nyquist)
+			max_freq = nyquist;
+		min_freq = std::max(min_freq, bin_hz);
+
+		// num_bands + 2 edges, band i rises from edge i to a peak at i + 1 and falls to i + 2
+		std::vector<float> edges(num_bands + 2);
+		const float lo = to_scale(scale, min_freq);
+		const float hi = to_scale(scale, max_freq);
+		for (int i = 0; i < num_bands + 2; i++)
+			edges[i] = from_scale(scale, lo + (hi - lo) * (float)i / (float)(num_bands + 1));
+
+		std::vector<float> band;
+		for (int i = 0; i < num_bands; i++) {
+			float left = edges[i], centre = edges[i + 1], right = edges[i + 2];
+			int first = std::max(0, (int)ceilf(left / bin_hz));
+			int last = std::min(fft_samples - 1, (int)floorf(right / bin_hz));
+
+			band.clear();
+			float sum = 0.f;
+			for (int k = first; k <= last; k++) {
+				float f = k * bin_hz;
+				float w = (f <= centre) ? (f - left) / (centre - left) : (right - f) / (right - centre);
+				w = std::max(w, 0.f);
+				band.push_back(w);
+				sum += w;
+			}
+
+			// Drop the zero-weight ends so the product only touches contributing bins
+			while (!band.empty() && band.back() <= 0.f)
+				band.pop_back();
+			while (!band.empty() && band.front() <= 0.f) {
+				band.erase(band.begin());
+				first++;
+			}
+
+			// Bands narrower than one FFT bin take the nearest bin outright
+			if (sum <= 0.f) {
+				first = std::min(fft_samples - 1, (int)roundf(centre / bin_hz));
+				band.assign(1, 1.f);
+				sum = 1.f;
+			}
+
+			for (float& w : band)
+				w /= sum;
+
+			add_band(first, band);
+		}
+	}
+
+	void BandMap::apply(const float* spectrum, float* out) const {
+		for (int i = 0; i < num_bands; i++) {
+			const float* w = &weights[offset[i]];
+			const float* s = spectrum + start[i];
+			float sum = 0.f;
+			for (int j = 0; j < count[i]; j++)
+				sum += w[j] * s[j];
+			out[i] = sum;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+namespace dsp {
+	enum class BandScale {
+		linear,		// Equal-width groups of FFT bins, box weighted
+		log,		// Log-frequency triangles
+		mel,		// Mel-scale triangles
+		erb			// ERB-rate triangles
+	};
+
+	// First FFT bin of linear band i, round(fft_samples * band / num_bands) in exact
+	// integer maths so it also works in constant expressions; band num_bands ends the last band
+	constexpr int linear_band_edge(int band, int fft_samples, int num_bands) {
+		return (int)((2LL * fft_samples * band + num_bands) / (2LL * num_bands));
+	}
+
+	// Sparse FFT bin -> band weight matrix, built once per (FFT size, band count,
+	// sample rate). Band i reads weights[offset[i] + j] * spectrum[start[i] + j]
+	// for j < count[i]; each band's weights sum to one.
+	class BandMap {
+	public:
+		BandMap(BandScale scale, int fft_samples, int num_bands, float sample_rate, float min_freq = 20.f, float max_freq = 0.f);
+
+		// Linear bands from precomputed boundaries, band i averages bins [edges[i], edges[i + 1])
+		BandMap(const int* edges, int fft_samples, int num_bands, float sample_rate);
+
+		// Dense reference of the sparse product, out holds num_bands floats
+		void apply(const float* spectrum, float* out) const;
+
+		BandScale scale;
+		int fft_samples;
+		int num_bands;
+		float sample_rate;
+
+		std::vector<int> start;
+		std::vector<int> count;
+		std::vector<int> offset;
+		std::vector<float> weights;
+
+		// Widest band in each group of 8, bounds vectorised loops
+		std::vector<int> group_width;
+
+	private:
+		void add_band(int first, const std::vector<float>& band_weights);
+		void build_linear(const int* edges);
+		void build_triangular(float min_freq, float max_freq);
+		void build_groups();
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "maths.h"
+#include "utils.h"
+
+// A way of drawing one horizontal bar per bin, stacked bottom to top from
+// bin_pos_x. Backends differ only in what is streamed to the GPU each frame
+// and how it becomes quads, so they can be swapped to compare them on a GPU.
+class BarBackend {
+public:
+	virtual ~BarBackend() {}
+
+	// Upload this frame's bar lengths
+	virtual void update(const float* bins) = 0;
+	virtual void draw(const maths::mat4& projection) = 0;
+	virtual void destroy() = 0;
+
+	// Frames where the CPU had to wait for the GPU to release an upload segment
+	virtual unsigned int upload_stalls() const = 0;
+
+	int num_bins;
+	float bin_height;
+	float bin_pos_x;
+	float loudness_scale;
+
+	maths::vec4 colour_quiet;
+	maths::vec4 colour_loud;
+
+	// Incremented once per glDraw* call issued, for comparing backends
+	unsigned int draw_calls;
+
+protected:
+	BarBackend(int num_bins, float bin_height, float bin_pos_x) :
+		num_bins(num_bins),
+		bin_height(bin_height),
+		bin_pos_x(bin_pos_x),
+		loudness_scale(400.f),
+		colour_quiet(utils::colour::green),
+		colour_loud(utils::colour::red),
+		draw_calls(0)
+	{
+	}
+};
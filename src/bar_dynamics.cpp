@@ -0,0 +1,89 @@
+#include "bar_dynamics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dsp {
+	// Fraction of the remaining distance a one-pole filter covers in one step
+	static float one_pole(double dt, float time_constant) {
+		return time_constant > 0.f ? (float)(1.0 - exp(-dt / time_constant)) : 1.f;
+	}
+
+	BarDynamics::BarDynamics(int num_bars, float scale, const DynamicsSettings& settings) :
+		num_bars(num_bars),
+		scale(scale),
+		settings(settings),
+		steps(0),
+		dt(1.0 / std::max(1.f, settings.step_rate)),
+		attack_k(one_pole(dt, settings.attack)),
+		release_k(one_pole(dt, settings.release)),
+		next_time(0.0),
+		hold(num_bars, 0.f),
+		velocity(num_bars, 0.f)
+	{
+		previous.level.assign(num_bars, 0.f);
+		previous.peak.assign(num_bars, 0.f);
+		current = previous;
+	}
+
+	bool BarDynamics::due(double time) {
+		// After a stall or seek, skip the missed steps rather than running them all in one frame
+		if (time - next_time > settings.max_lag)
+			next_time = time - fmod(time - next_time, dt);
+		return next_time <= time;
+	}
+
+	void BarDynamics::step(const float* levels) {
+		previous.level.swap(current.level);
+		previous.peak.swap(current.peak);
+
+		const float fdt = (float)dt;
+		for (int i = 0; i < num_bars; i++) {
+			float old = previous.level[i];
+			float target = levels[i];
+			float level = old + (target - old) * (target > old ? attack_k : release_k);
+			current.level[i] = level;
+
+			// Peaks catch the level, hold, then fall under gravity until they meet it again
+			float peak = previous.peak[i];
+			if (level >= peak) {
+				peak = level;
+				hold[i] = settings.peak_hold;
+				velocity[i] = 0.f;
+			}
+			else if (hold[i] > 0.f) {
+				hold[i] -= fdt;
+			}
+			else {
+				velocity[i] += settings.peak_gravity * fdt;
+				peak = std::max(level, peak - velocity[i] * fdt);
+			}
+			current.peak[i] = peak;
+		}
+
+		skip();
+	}
+
+	void BarDynamics::skip() {
+		next_time += dt;
+		steps++;
+	}
+
+	float BarDynamics::blend(double time) const {
+		// current is the state at next_time - dt, previous one step before it
+		return (float)std::min(std::max((time - (next_time - dt)) / dt, 0.0), 1.0);
+	}
+
+	void BarDynamics::interpolate(double time, float* bars, float* peaks) const {
+		const float t = blend(time);
+
+		if (bars) {
+			for (int i = 0; i < num_bars; i++)
+				bars[i] = (previous.level[i] + (current.level[i] - previous.level[i]) * t) * scale;
+		}
+		if (peaks) {
+			for (int i = 0; i < num_bars; i++)
+				peaks[i] = (previous.peak[i] + (current.peak[i] - previous.peak[i]) * t) * scale;
+		}
+	}
+}
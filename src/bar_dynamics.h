@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+namespace dsp {
+	struct DynamicsSettings {
+		float step_rate = 120.f;		// Simulation steps per second
+		float attack = 0.024f;			// Rise time constant in seconds
+		float release = 0.15f;			// Fall time constant in seconds
+		float peak_hold = 0.5f;			// Seconds a peak stays put before falling
+		float peak_gravity = 2.f;		// Peak fall acceleration in levels per second squared
+		float max_lag = 0.25f;			// Falling further behind than this jumps the clock instead of catching up
+	};
+
+	// Bar dynamics on a fixed timestep, so the look does not depend on the
+	// render rate. The caller steps the simulation on the audio clock, feeding
+	// each step the band levels (0-1) at step_time(), then renders the previous
+	// and current states blended by how far the clock is past the last step:
+	//
+	//   while (dynamics.due(time)) {
+	//       levels_at(dynamics.step_time(), levels);
+	//       dynamics.step(levels);
+	//   }
+	//   dynamics.interpolate(time, bars, peaks);
+	//
+	// The result lags the clock by one step in exchange for never extrapolating.
+	class BarDynamics {
+	public:
+		BarDynamics(int num_bars, float scale, const DynamicsSettings& settings = DynamicsSettings());
+
+		// True while a step is due at or before time
+		bool due(double time);
+		double step_time() const { return next_time; }
+
+		// Advance one step towards levels
+		void step(const float* levels);
+
+		// Advance the clock one step without simulating, for when the step runs elsewhere (GpuSpectrum)
+		void skip();
+
+		// Bar and peak lengths at time, scaled to scale; either may be nullptr
+		void interpolate(double time, float* bars, float* peaks) const;
+
+		// How far time is from the previous state to the current one, 0-1
+		float blend(double time) const;
+
+		int num_bars;
+		float scale;
+		DynamicsSettings settings;
+
+		// Steps run since construction, for profiling
+		unsigned long long steps;
+
+		// Step length and the per-step smoothing factors derived from the time constants
+		double dt;
+		float attack_k;
+		float release_k;
+
+	private:
+		struct State {
+			std::vector<float> level;
+			std::vector<float> peak;
+		};
+
+		double next_time;
+
+		State previous;
+		State current;
+		std::vector<float> hold;
+		std::vector<float> velocity;
+	};
+}
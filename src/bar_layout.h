@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <utility>
+
+#include "band_map.h"
+#include "maths.h"
+
+template <int FFT_SIZE, int NUM_BINS, std::size_t... I>
+constexpr std::array<int, NUM_BINS + 1> make_bar_edges(std::index_sequence<I...>) {
+	return {{ dsp::linear_band_edge((int)I, FFT_SIZE / 2, NUM_BINS)... }};
+}
+
+template <int NUM_BINS, int RES_X, int RES_Y, std::size_t... I>
+constexpr std::array<maths::vec2, NUM_BINS> make_bar_centres(std::index_sequence<I...>) {
+	return {{ maths::vec2{ (float)RES_X * 0.5f, ((float)I + 0.5f) * ((float)RES_Y / (float)NUM_BINS) }... }};
+}
+
+// Bin boundaries and bar geometry for a fixed <FFT_SIZE, NUM_BINS, RES_X, RES_Y>,
+// evaluated entirely at compile time so fixed configurations do no setup maths.
+template <int FFT_SIZE, int NUM_BINS, int RES_X, int RES_Y>
+struct BarLayout {
+	static_assert(FFT_SIZE > 0 && (FFT_SIZE & (FFT_SIZE - 1)) == 0, "FFT_SIZE must be a power of two");
+	static_assert(NUM_BINS > 0 && NUM_BINS <= FFT_SIZE / 2, "NUM_BINS must be in [1, FFT_SIZE / 2]");
+
+	static constexpr int fft_samples = FFT_SIZE / 2;
+	static constexpr int num_bins = NUM_BINS;
+
+	static constexpr maths::vec2 resolution{ (float)RES_X, (float)RES_Y };
+	static constexpr float bin_height = (float)RES_Y / (float)NUM_BINS;
+	static constexpr float bin_pos_x = (float)RES_X * 0.5f;
+
+	static constexpr maths::mat4 projection = maths::orthographic_matrix(resolution, -1.f, 1.f, maths::mat4());
+
+	// Bar i averages FFT bins [edges[i], edges[i + 1])
+	static constexpr std::array<int, NUM_BINS + 1> edges = make_bar_edges<FFT_SIZE, NUM_BINS>(std::make_index_sequence<NUM_BINS + 1>());
+
+	// Centre of bar i, bars stacked bottom to top
+	static constexpr std::array<maths::vec2, NUM_BINS> centres = make_bar_centres<NUM_BINS, RES_X, RES_Y>(std::make_index_sequence<NUM_BINS>());
+};
+
+template <int FFT_SIZE, int NUM_BINS, int RES_X, int RES_Y>
+constexpr maths::vec2 BarLayout<FFT_SIZE, NUM_BINS, RES_X, RES_Y>::resolution;
+
+template <int FFT_SIZE, int NUM_BINS, int RES_X, int RES_Y>
+constexpr maths::mat4 BarLayout<FFT_SIZE, NUM_BINS, RES_X, RES_Y>::projection;
+
+template <int FFT_SIZE, int NUM_BINS, int RES_X, int RES_Y>
+constexpr std::array<int, NUM_BINS + 1> BarLayout<FFT_SIZE, NUM_BINS, RES_X, RES_Y>::edges;
+
+template <int FFT_SIZE, int NUM_BINS, int RES_X, int RES_Y>
+constexpr std::array<maths::vec2, NUM_BINS> BarLayout<FFT_SIZE, NUM_BINS, RES_X, RES_Y>::centres;
@@ -0,0 +1,79 @@
+#include "bar_renderer.h"
+#include "utils.h"
+
+#include <algorithm>
+
+BarRenderer::BarRenderer(int num_bins, const maths::vec2& resolution) :
+	BarRenderer(num_bins, resolution.y / (float)num_bins, resolution.x * 0.5f)
+{
+}
+
+BarRenderer::BarRenderer(int num_bins, float bin_height, float bin_pos_x) :
+	BarBackend(num_bins, bin_height, bin_pos_x),
+	shader("shaders/v.instanced_bars.glsl", "shaders/f.vertex_colour.glsl"),
+	instances(GL_ARRAY_BUFFER, num_bins * sizeof(float))
+{
+	u_projection = shader.uniform("projection");
+	u_bin_height = shader.uniform("bin_height");
+	u_bin_pos_x = shader.uniform("bin_pos_x");
+	u_loudness_scale = shader.uniform("loudness_scale");
+	u_colour_quiet = shader.uniform("colour_quiet");
+	u_colour_loud = shader.uniform("colour_loud");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// Shared unit quad
+	glGenBuffers(1, &vbo_quad);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_quad);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(utils::mesh::quad_points_textured), &utils::mesh::quad_points_textured, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+	// One bar length per instance, each frame's segment is selected with the base instance
+	glBindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float), 0);
+	glVertexAttribDivisor(2, 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void BarRenderer::update(const float* bins) {
+	float* dst = (float*)instances.map_next();
+	std::copy(bins, bins + num_bins, dst);
+}
+
+GLuint BarRenderer::next_instances(GLint& first) {
+	instances.map_next();
+	first = instances.segment * num_bins;
+	return instances.buffer;
+}
+
+void BarRenderer::draw(const maths::mat4& projection) {
+	shader.use();
+	shader.set_uniform(u_projection, projection);
+	shader.set_uniform(u_bin_height, bin_height);
+	shader.set_uniform(u_bin_pos_x, bin_pos_x);
+	shader.set_uniform(u_loudness_scale, loudness_scale);
+	shader.set_uniform(u_colour_quiet, colour_quiet);
+	shader.set_uniform(u_colour_loud, colour_loud);
+
+	glBindVertexArray(vao);
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, num_bins, instances.segment * num_bins);
+	draw_calls++;
+	glBindVertexArray(0);
+	instances.fence();
+
+	shader.release();
+}
+
+void BarRenderer::destroy() {
+	instances.destroy();
+	glDeleteBuffers(1, &vbo_quad);
+	glDeleteVertexArrays(1, &vao);
+	shader.destroy();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include "bar_backend.h"
+#include "maths.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+// Draws every frequency bar with a single instanced call. Only the bar lengths
+// are streamed each frame, through a triple-buffered persistent mapping;
+// placement and the quiet->loud colour ramp are derived per instance in
+// shaders/v.instanced_bars.glsl.
+class BarRenderer : public BarBackend {
+public:
+	BarRenderer(int num_bins, const maths::vec2& resolution);
+
+	// Precomputed placement, e.g. from a compile-time BarLayout
+	BarRenderer(int num_bins, float bin_height, float bin_pos_x);
+
+	void update(const float* bins) override;
+
+	// Instead of update(), for a compute pass that writes the lengths itself:
+	// advance to the next instance segment and return its buffer, with the
+	// index of the segment's first float in first
+	GLuint next_instances(GLint& first);
+	void draw(const maths::mat4& projection) override;
+	void destroy() override;
+
+	unsigned int upload_stalls() const override { return instances.stalls; }
+
+private:
+	utils::Shader shader;
+	utils::Uniform u_projection;
+	utils::Uniform u_bin_height;
+	utils::Uniform u_bin_pos_x;
+	utils::Uniform u_loudness_scale;
+	utils::Uniform u_colour_quiet;
+	utils::Uniform u_colour_loud;
+
+	GLuint vao;
+	GLuint vbo_quad;
+	utils::StreamBuffer instances;
+};
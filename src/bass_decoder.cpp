@@ -0,0 +1,63 @@
+#include "bass_decoder.h"
+
+namespace dsp {
+	std::unique_ptr<Decoder> BassDecoder::open(const std::shared_ptr<utils::MappedFile>& file) {
+		HSTREAM stream = BASS_StreamCreateFile(true, file->data, 0, file->size, BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT);
+		if (!stream)
+			return nullptr;
+
+		BASS_CHANNELINFO info;
+		BASS_ChannelGetInfo(stream, &info);
+
+		std::unique_ptr<BassDecoder> decoder{ new BassDecoder(file, stream) };
+		decoder->sample_rate = (int)info.freq;
+		decoder->channels = (int)info.chans;
+
+		// Without a prescan this is an estimate for VBR files, good enough for display
+		QWORD bytes = BASS_ChannelGetLength(stream, BASS_POS_BYTE);
+		if (bytes != (QWORD)-1)
+			decoder->length = (long long)(bytes / (info.chans * sizeof(float)));
+
+		return std::move(decoder);
+	}
+
+	BassDecoder::BassDecoder(const std::shared_ptr<utils::MappedFile>& file, HSTREAM stream) :
+		file(file),
+		stream(stream)
+	{
+	}
+
+	BassDecoder::~BassDecoder() {
+		BASS_StreamFree(stream);
+	}
+
+	int BassDecoder::read(float* out, int frames) {
+		const DWORD frame_bytes = (DWORD)(channels * sizeof(float));
+		int done = 0;
+
+		// Decoding channels can return less than asked mid-file, keep going until full or ended
+		while (done < frames) {
+			DWORD bytes = BASS_ChannelGetData(stream, out + done * channels, (DWORD)(frames - done) * frame_bytes | BASS_DATA_FLOAT);
+			if (bytes == (DWORD)-1 || bytes == 0)
+				break;
+			done += (int)(bytes / frame_bytes);
+		}
+
+		return done;
+	}
+
+	static DWORD CALLBACK stream_proc(HSTREAM handle, void* buffer, DWORD length, void* user) {
+		Decoder* decoder = (Decoder*)user;
+		const DWORD frame_bytes = (DWORD)(decoder->channels * sizeof(float));
+
+		int wanted = (int)(length / frame_bytes);
+		int frames = decoder->read((float*)buffer, wanted);
+
+		DWORD bytes = (DWORD)frames * frame_bytes;
+		return frames < wanted ? bytes | BASS_STREAMPROC_END : bytes;
+	}
+
+	HSTREAM create_playback_stream(Decoder* decoder) {
+		return BASS_StreamCreate((DWORD)decoder->sample_rate, (DWORD)decoder->channels, BASS_SAMPLE_FLOAT, &stream_proc, decoder);
+	}
+}
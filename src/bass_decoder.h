@@ -0,0 +1,28 @@
+#pragma once
+
+#include <bass.h>
+
+#include "decoder.h"
+
+namespace dsp {
+	// Compressed formats (MP3, OGG, ...) decoded by BASS straight from the
+	// mapped file, without a prescan. Register with register_decoder() after
+	// BASS_Init.
+	class BassDecoder : public Decoder {
+	public:
+		static std::unique_ptr<Decoder> open(const std::shared_ptr<utils::MappedFile>& file);
+		~BassDecoder();
+
+		int read(float* out, int frames) override;
+
+	private:
+		BassDecoder(const std::shared_ptr<utils::MappedFile>& file, HSTREAM stream);
+
+		std::shared_ptr<utils::MappedFile> file;
+		HSTREAM stream;
+	};
+
+	// Playable BASS stream that pulls fixed-size chunks from the decoder as its
+	// playback buffer drains. The decoder must outlive the stream.
+	HSTREAM create_playback_stream(Decoder* decoder);
+}
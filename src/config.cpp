@@ -0,0 +1,218 @@
+#include "config.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static bool parse_int(const char* value, int& out) {
+	char* end;
+	long v = strtol(value, &end, 10);
+	if (end == value || *end != '\0')
+		return false;
+	out = (int)v;
+	return true;
+}
+
+static bool parse_float(const char* value, float& out) {
+	char* end;
+	float v = strtof(value, &end);
+	if (end == value || *end != '\0')
+		return false;
+	out = v;
+	return true;
+}
+
+static bool parse_bool(const char* value, bool& out) {
+	if (!strcmp(value, "1") || !strcmp(value, "true") || !strcmp(value, "on") || !strcmp(value, "yes"))
+		out = true;
+	else if (!strcmp(value, "0") || !strcmp(value, "false") || !strcmp(value, "off") || !strcmp(value, "no"))
+		out = false;
+	else
+		return false;
+	return true;
+}
+
+static bool parse_window(const char* value, dsp::Window& out) {
+	if (!strcmp(value, "hann"))
+		out = dsp::Window::hann;
+	else if (!strcmp(value, "blackman_harris"))
+		out = dsp::Window::blackman_harris;
+	else if (!strcmp(value, "kaiser"))
+		out = dsp::Window::kaiser;
+	else
+		return false;
+	return true;
+}
+
+static bool parse_band_scale(const char* value, dsp::BandScale& out) {
+	if (!strcmp(value, "linear"))
+		out = dsp::BandScale::linear;
+	else if (!strcmp(value, "log"))
+		out = dsp::BandScale::log;
+	else if (!strcmp(value, "mel"))
+		out = dsp::BandScale::mel;
+	else if (!strcmp(value, "erb"))
+		out = dsp::BandScale::erb;
+	else
+		return false;
+	return true;
+}
+
+// "WxH"
+static bool parse_resolution(const char* value, int& width, int& height) {
+	char* end;
+	long w = strtol(value, &end, 10);
+	if (end == value || (*end != 'x' && *end != 'X'))
+		return false;
+	const char* h_start = end + 1;
+	long h = strtol(h_start, &end, 10);
+	if (end == h_start || *end != '\0')
+		return false;
+	width = (int)w;
+	height = (int)h;
+	return true;
+}
+
+static const char* const keys[] = {
+	"tune", "fft_size", "hop_size", "window", "kaiser_beta", "bands", "band_scale", "analysis_threads",
+	"resolution", "fullscreen", "vsync", "frame_cap", "spectrogram_history"
+};
+
+static bool is_key(const char* key) {
+	for (const char* k : keys)
+		if (!strcmp(key, k))
+			return true;
+	return false;
+}
+
+static bool is_power_of_two(int v) {
+	return v > 0 && (v & (v - 1)) == 0;
+}
+
+static void trim(char*& begin, char*& end) {
+	while (begin < end && isspace((unsigned char)*begin))
+		begin++;
+	while (end > begin && isspace((unsigned char)end[-1]))
+		end--;
+	*end = '\0';
+}
+
+bool Config::set(const char* key, const char* value) {
+	if (!strcmp(key, "tune")) {
+		if (!*value)
+			return false;
+		tune = value;
+		return true;
+	}
+	if (!strcmp(key, "fft_size"))
+		return parse_int(value, fft_size);
+	if (!strcmp(key, "hop_size"))
+		return parse_int(value, hop_size);
+	if (!strcmp(key, "window"))
+		return parse_window(value, window);
+	if (!strcmp(key, "kaiser_beta"))
+		return parse_float(value, kaiser_beta);
+	if (!strcmp(key, "bands"))
+		return parse_int(value, num_bins);
+	if (!strcmp(key, "band_scale"))
+		return parse_band_scale(value, band_scale);
+	if (!strcmp(key, "analysis_threads"))
+		return parse_int(value, analysis_threads);
+	if (!strcmp(key, "resolution"))
+		return parse_resolution(value, width, height);
+	if (!strcmp(key, "fullscreen"))
+		return parse_bool(value, fullscreen);
+	if (!strcmp(key, "vsync"))
+		return parse_bool(value, vsync);
+	if (!strcmp(key, "frame_cap"))
+		return parse_int(value, frame_cap);
+	if (!strcmp(key, "spectrogram_history"))
+		return parse_int(value, spectrogram_history);
+	return false;
+}
+
+bool Config::load(const char* path, bool required) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		if (required)
+			fprintf(stderr, "*** Config Error: Cannot read %s\n", path);
+		return !required;
+	}
+
+	bool ok = true;
+	char line[1024];
+	for (int number = 1; fgets(line, sizeof(line), file); number++) {
+		if (char* comment = strchr(line, '#'))
+			*comment = '\0';
+
+		char* begin = line;
+		char* end = line + strlen(line);
+		trim(begin, end);
+		if (begin == end)
+			continue;
+
+		char* equals = strchr(begin, '=');
+		if (!equals) {
+			fprintf(stderr, "*** Config Error: %s:%d: expected key = value\n", path, number);
+			ok = false;
+			continue;
+		}
+
+		char* key = begin;
+		char* key_end = equals;
+		char* value = equals + 1;
+		trim(key, key_end);
+		trim(value, end);
+
+		if (!set(key, value)) {
+			fprintf(stderr, "*** Config Error: %s:%d: bad setting %s = %s\n", path, number, key, value);
+			ok = false;
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+bool Config::parse_args(int argc, char* argv[]) {
+	bool ok = true;
+	char key[64];
+	for (int i = 1; i < argc - 1; i++) {
+		const char* arg = argv[i];
+		if (strncmp(arg, "--", 2) != 0 || strlen(arg + 2) >= sizeof(key))
+			continue;
+
+		strcpy(key, arg + 2);
+		for (char* c = key; *c; c++)
+			if (*c == '-')
+				*c = '_';
+		if (!is_key(key))
+			continue;
+
+		if (!set(key, argv[i + 1])) {
+			fprintf(stderr, "*** Config Error: bad value %s for %s\n", argv[i + 1], arg);
+			ok = false;
+		}
+		i++;
+	}
+	return ok;
+}
+
+const char* Config::validate() const {
+	if (!is_power_of_two(fft_size) || fft_size < dsp::FFT::min_size || fft_size > dsp::FFT::max_size)
+		return "fft_size must be a power of two the FFT supports";
+	if (hop_size < 1 || hop_size > fft_size)
+		return "hop_size must be in [1, fft_size]";
+	if (num_bins < 1 || num_bins > fft_size / 2)
+		return "bands must be in [1, fft_size / 2]";
+	if (width < 1 || height < 1)
+		return "resolution must be at least 1x1";
+	if (frame_cap < 0)
+		return "frame_cap must not be negative";
+	if (analysis_threads < 0)
+		return "analysis_threads must not be negative";
+	if (spectrogram_history < 1 || spectrogram_history > max_spectrogram_history)
+		return "spectrogram_history must be in [1, 16384]";
+	return nullptr;
+}
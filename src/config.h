@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include "band_map.h"
+#include "fft.h"
+
+// Startup settings, so one build serves every screen. Read once from a
+// "key = value" file and then the command line ("--fft-size 4096" sets
+// fft_size), before anything is created; only plan and buffer sizes come
+// from it, so nothing in the frame loop ever looks at it.
+struct Config {
+	std::string tune = "music/Rolemusic_-_pl4y1ng.mp3";
+
+	// Analysis
+	int fft_size = 2048;
+	int hop_size = 512;
+	dsp::Window window = dsp::Window::hann;
+	float kaiser_beta = 8.6f;
+	int num_bins = 512;
+	dsp::BandScale band_scale = dsp::BandScale::log;
+
+	// Threads building the spectrum cache, 0 means one per hardware thread
+	int analysis_threads = 0;
+
+	// Display
+	int width = 800;
+	int height = 600;
+	bool fullscreen = false;
+	bool vsync = true;
+	int frame_cap = 0;			// Frames per second, 0 for none
+	int spectrogram_history = 4096;
+
+	// Rows of spectrogram texture; SpectrogramRenderer::fits also bounds it with the band count
+	static const int max_spectrogram_history = 16384;
+
+	// Apply one setting; false for an unknown key or a value it cannot take
+	bool set(const char* key, const char* value);
+
+	// Apply a settings file, '#' starts a comment. False if a line is bad, or
+	// if the file cannot be read and is required.
+	bool load(const char* path, bool required = true);
+
+	// Apply every "--key value" whose key is a setting, dashes standing for
+	// underscores, and leave the other arguments alone. False on a bad value.
+	bool parse_args(int argc, char* argv[]);
+
+	// nullptr if the sizes are usable, otherwise what is wrong with them
+	const char* validate() const;
+};
@@ -0,0 +1,30 @@
+#include "cpu.h"
+
+#if defined(_MSC_VER) && defined(CPU_X86)
+#include <intrin.h>
+#endif
+
+namespace utils {
+	static bool detect_avx2() {
+#if defined(CPU_X86) && defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(CPU_X86)
+		return __builtin_cpu_supports("avx2") != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool cpu_has_avx2() {
+		static const bool has_avx2 = detect_avx2();
+		return has_avx2;
+	}
+}
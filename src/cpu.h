@@ -0,0 +1,19 @@
+#pragma once
+
+// Function attribute for code paths compiled for AVX2 but selected at runtime.
+// MSVC accepts AVX2 intrinsics without it; GCC and Clang need it per function.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CPU_TARGET_AVX2
+#else
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CPU_NEON 1
+#endif
+
+namespace utils {
+	// True when both the CPU and the OS support AVX2, checked once
+	bool cpu_has_avx2();
+}
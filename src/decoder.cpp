@@ -0,0 +1,27 @@
+#include "decoder.h"
+#include "wav_decoder.h"
+
+#include <vector>
+
+namespace dsp {
+	static std::vector<DecoderFactory>& factories() {
+		static std::vector<DecoderFactory> registered{ &WavDecoder::open };
+		return registered;
+	}
+
+	void register_decoder(DecoderFactory factory) {
+		factories().push_back(factory);
+	}
+
+	std::unique_ptr<Decoder> open_decoder(const char* path) {
+		std::shared_ptr<utils::MappedFile> file = std::make_shared<utils::MappedFile>(path);
+		if (!file->is_open())
+			return nullptr;
+
+		for (DecoderFactory factory : factories())
+			if (std::unique_ptr<Decoder> decoder = factory(file))
+				return decoder;
+
+		return nullptr;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+
+#include "mapped_file.h"
+
+namespace dsp {
+	// Pull-based PCM source. Each read() converts only the next chunk of the
+	// input into the caller's buffer, so no decoder holds the whole track.
+	class Decoder {
+	public:
+		virtual ~Decoder() {}
+
+		// Write up to frames interleaved float frames to out. Returns the number
+		// written, which is only short of frames at the end of the track.
+		virtual int read(float* out, int frames) = 0;
+
+		int sample_rate;
+		int channels;
+		long long length;	// In frames, -1 if unknown
+
+	protected:
+		Decoder() : sample_rate(0), channels(0), length(-1) {}
+	};
+
+	// Returns a decoder reading from the mapped file, or nullptr if the file is not in its format
+	typedef std::unique_ptr<Decoder> (*DecoderFactory)(const std::shared_ptr<utils::MappedFile>& file);
+
+	// Hook for formats without a native reader. Factories are tried in
+	// registration order after the built-in WAV reader; register at startup.
+	void register_decoder(DecoderFactory factory);
+
+	// Memory-map path and hand it to the first decoder that accepts it, nullptr if none do
+	std::unique_ptr<Decoder> open_decoder(const char* path);
+}
@@ -0,0 +1,242 @@
+#include "fft.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "cpu.h"
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#elif defined(CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace dsp {
+	static const double TAU = 6.283185307179586;
+
+	static float hann(int i, int size) {
+		return (float)(0.5 - 0.5 * cos(TAU * i / size));
+	}
+
+	// Zeroth-order modified Bessel function of the first kind, by its power series
+	static double bessel_i0(double x) {
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	void make_window(Window window, int size, float kaiser_beta, float* out) {
+		switch (window) {
+		case Window::hann:
+			for (int i = 0; i < size; i++)
+				out[i] = hann(i, size);
+			break;
+		case Window::blackman_harris:
+			for (int i = 0; i < size; i++) {
+				double a = TAU * i / size;
+				out[i] = (float)(0.35875 - 0.48829 * cos(a) + 0.14128 * cos(2.0 * a) - 0.01168 * cos(3.0 * a));
+			}
+			break;
+		case Window::kaiser: {
+			const double norm = 1.0 / bessel_i0(kaiser_beta);
+			for (int i = 0; i < size; i++) {
+				double x = 2.0 * i / size - 1.0;
+				out[i] = (float)(bessel_i0(kaiser_beta * sqrt(1.0 - x * x)) * norm);
+			}
+			break;
+		}
+		}
+	}
+
+	FFT::FFT(int size, Window window_type, float kaiser_beta) : size(size), num_bins(size / 2), half(size / 2), log2_half(0) {
+		assert(size >= min_size && size <= max_size && (size & (size - 1)) == 0);
+
+		select_isa();
+
+		while ((1 << log2_half) < half)
+			log2_half++;
+
+		bit_reverse.resize(half);
+		for (int i = 0; i < half; i++) {
+			int r = 0;
+			for (int b = 0; b < log2_half; b++)
+				r |= ((i >> b) & 1) << (log2_half - 1 - b);
+			bit_reverse[i] = r;
+		}
+
+		window.resize(size);
+		make_window(window_type, size, kaiser_beta, window.data());
+
+		twiddle_re.resize(half);
+		twiddle_im.resize(half);
+		for (int h = 1; h < half; h <<= 1) {
+			for (int j = 0; j < h; j++) {
+				double a = -TAU * j / (2 * h);
+				twiddle_re[h - 1 + j] = (float)cos(a);
+				twiddle_im[h - 1 + j] = (float)sin(a);
+			}
+		}
+
+		unpack_re.resize(half);
+		unpack_im.resize(half);
+		for (int k = 0; k < half; k++) {
+			double a = -TAU * k / size;
+			unpack_re[k] = (float)cos(a);
+			unpack_im[k] = (float)sin(a);
+		}
+
+		re.resize(half);
+		im.resize(half);
+	}
+
+	// One radix-2 stage of span h over the whole array, butterflies from j = first
+	static void stage_scalar_from(int first, float* r, float* m, const float* wr, const float* wi, int half, int h) {
+		for (int s = 0; s < half; s += 2 * h) {
+			float* ar = r + s;
+			float* ai = m + s;
+			float* br = r + s + h;
+			float* bi = m + s + h;
+			for (int j = first; j < h; j++) {
+				float vr = br[j] * wr[j] - bi[j] * wi[j];
+				float vi = br[j] * wi[j] + bi[j] * wr[j];
+				float ur = ar[j];
+				float ui = ai[j];
+				ar[j] = ur + vr;
+				ai[j] = ui + vi;
+				br[j] = ur - vr;
+				bi[j] = ui - vi;
+			}
+		}
+	}
+
+	static void stage_scalar(float* r, float* m, const float* wr, const float* wi, int half, int h) {
+		stage_scalar_from(0, r, m, wr, wi, half, h);
+	}
+
+#if defined(CPU_X86)
+	CPU_TARGET_AVX2 static void stage_avx2(float* r, float* m, const float* wr, const float* wi, int half, int h) {
+		if (h < 8) {
+			stage_scalar_from(0, r, m, wr, wi, half, h);
+			return;
+		}
+
+		// h is a power of two, so every butterfly falls in a whole vector
+		for (int s = 0; s < half; s += 2 * h) {
+			float* ar = r + s;
+			float* ai = m + s;
+			float* br = r + s + h;
+			float* bi = m + s + h;
+			for (int j = 0; j < h; j += 8) {
+				__m256 tr = _mm256_loadu_ps(wr + j);
+				__m256 ti = _mm256_loadu_ps(wi + j);
+				__m256 xr = _mm256_loadu_ps(br + j);
+				__m256 xi = _mm256_loadu_ps(bi + j);
+				__m256 vr = _mm256_sub_ps(_mm256_mul_ps(xr, tr), _mm256_mul_ps(xi, ti));
+				__m256 vi = _mm256_add_ps(_mm256_mul_ps(xr, ti), _mm256_mul_ps(xi, tr));
+				__m256 ur = _mm256_loadu_ps(ar + j);
+				__m256 ui = _mm256_loadu_ps(ai + j);
+				_mm256_storeu_ps(ar + j, _mm256_add_ps(ur, vr));
+				_mm256_storeu_ps(ai + j, _mm256_add_ps(ui, vi));
+				_mm256_storeu_ps(br + j, _mm256_sub_ps(ur, vr));
+				_mm256_storeu_ps(bi + j, _mm256_sub_ps(ui, vi));
+			}
+		}
+	}
+#elif defined(CPU_NEON)
+	static void stage_neon(float* r, float* m, const float* wr, const float* wi, int half, int h) {
+		if (h < 4) {
+			stage_scalar_from(0, r, m, wr, wi, half, h);
+			return;
+		}
+
+		for (int s = 0; s < half; s += 2 * h) {
+			float* ar = r + s;
+			float* ai = m + s;
+			float* br = r + s + h;
+			float* bi = m + s + h;
+			for (int j = 0; j < h; j += 4) {
+				float32x4_t tr = vld1q_f32(wr + j);
+				float32x4_t ti = vld1q_f32(wi + j);
+				float32x4_t xr = vld1q_f32(br + j);
+				float32x4_t xi = vld1q_f32(bi + j);
+				float32x4_t vr = vmlsq_f32(vmulq_f32(xr, tr), xi, ti);
+				float32x4_t vi = vmlaq_f32(vmulq_f32(xr, ti), xi, tr);
+				float32x4_t ur = vld1q_f32(ar + j);
+				float32x4_t ui = vld1q_f32(ai + j);
+				vst1q_f32(ar + j, vaddq_f32(ur, vr));
+				vst1q_f32(ai + j, vaddq_f32(ui, vi));
+				vst1q_f32(br + j, vsubq_f32(ur, vr));
+				vst1q_f32(bi + j, vsubq_f32(ui, vi));
+			}
+		}
+	}
+#endif
+
+	void FFT::select_isa() {
+#if defined(CPU_X86)
+		if (utils::cpu_has_avx2()) {
+			isa = "avx2";
+			stage = stage_avx2;
+		}
+		else {
+			isa = "scalar";
+			stage = stage_scalar;
+		}
+#elif defined(CPU_NEON)
+		isa = "neon";
+		stage = stage_neon;
+#else
+		isa = "scalar";
+		stage = stage_scalar;
+#endif
+	}
+
+	void FFT::transform() {
+		for (int h = 1; h < half; h <<= 1)
+			stage(re.data(), im.data(), &twiddle_re[h - 1], &twiddle_im[h - 1], half, h);
+	}
+
+	void FFT::magnitudes(const float* samples, float* out) {
+		// Pack even/odd samples as real/imaginary parts, in bit-reversed order
+		for (int n = 0; n < half; n++) {
+			int k = bit_reverse[n];
+			re[k] = samples[2 * n] * window[2 * n];
+			im[k] = samples[2 * n + 1] * window[2 * n + 1];
+		}
+
+		transform();
+
+		// Split the half-size result into even and odd spectra and recombine
+		const float scale = 2.f / (float)size;
+		for (int k = 0; k < half; k++) {
+			int nk = (half - k) & (half - 1);
+			float zr = re[k], zi = im[k];
+			float cr = re[nk], ci = -im[nk];
+
+			float er = 0.5f * (zr + cr);
+			float ei = 0.5f * (zi + ci);
+			float or_ = 0.5f * (zi - ci);
+			float oi = -0.5f * (zr - cr);
+
+			float xr = er + (unpack_re[k] * or_ - unpack_im[k] * oi);
+			float xi = ei + (unpack_re[k] * oi + unpack_im[k] * or_);
+			out[k] = sqrtf(xr * xr + xi * xi) * scale;
+		}
+	}
+
+	void dft_magnitudes(const float* samples, int size, float* out) {
+		for (int k = 0; k < size / 2; k++) {
+			double xr = 0.0, xi = 0.0;
+			for (int n = 0; n < size; n++) {
+				double x = samples[n] * hann(n, size);
+				double a = -TAU * ((long long)k * n % size) / size;
+				xr += x * cos(a);
+				xi += x * sin(a);
+			}
+			out[k] = (float)(sqrt(xr * xr + xi * xi) * 2.0 / size);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+namespace dsp {
+	enum class Window {
+		hann,				// Good general default, -31 dB sidelobes
+		blackman_harris,	// 4-term, -92 dB sidelobes for wide dynamic range
+		kaiser				// Sidelobes traded against main lobe width with beta
+	};
+
+	// Periodic window of size samples, so overlapping frames sum evenly
+	void make_window(Window window, int size, float kaiser_beta, float* out);
+
+	// Real-input FFT of one fixed power-of-two size (256 - 65536), planned once.
+	// The N real samples are packed into an N/2 point complex transform which is
+	// run in place on split real/imaginary arrays, then unpacked into the N/2
+	// positive-frequency bins. Stages wide enough use AVX2, picked at runtime as
+	// BinKernel does, or NEON; everything else runs the scalar path.
+	class FFT {
+	public:
+		static const int min_size = 256;
+		static const int max_size = 65536;
+
+		explicit FFT(int size, Window window = Window::hann, float kaiser_beta = 8.6f);
+
+		// Windowed magnitude spectrum; out must hold size / 2 floats
+		void magnitudes(const float* samples, float* out);
+
+		int size;
+		int num_bins;
+
+		// Selected butterfly implementation: "avx2", "neon" or "scalar"
+		const char* isa;
+
+	private:
+		typedef void (*StageFn)(float* re, float* im, const float* twiddle_re, const float* twiddle_im, int half, int h);
+
+		void select_isa();
+		void transform();
+
+		StageFn stage;
+
+		int half;
+		int log2_half;
+
+		std::vector<int> bit_reverse;
+		std::vector<float> window;
+
+		// Butterfly twiddles for every stage, stage with span h starts at offset h - 1
+		std::vector<float> twiddle_re;
+		std::vector<float> twiddle_im;
+
+		// exp(-2*pi*i*k / size), used to unpack the half-size complex result
+		std::vector<float> unpack_re;
+		std::vector<float> unpack_im;
+
+		std::vector<float> re;
+		std::vector<float> im;
+	};
+
+	// O(n^2) reference with the same window and scaling as FFT::magnitudes
+	void dft_magnitudes(const float* samples, int size, float* out);
+}
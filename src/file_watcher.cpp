@@ -0,0 +1,118 @@
+#include "file_watcher.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace utils {
+	// Editors often write a file in several steps, wait for them to finish before reporting it
+	static const std::chrono::milliseconds settle_time{ 50 };
+
+	FileWatcher::FileWatcher(const std::vector<std::string>& paths, std::function<void()> on_change) :
+		paths(paths),
+		on_change(on_change),
+		stop(false),
+		thread(&FileWatcher::run, this)
+	{
+	}
+
+	FileWatcher::~FileWatcher() {
+		stop = true;
+		thread.join();
+	}
+
+#ifdef __linux__
+	static void split_path(const std::string& path, std::string& directory, std::string& name) {
+		size_t slash = path.find_last_of('/');
+		directory = slash == std::string::npos ? "." : path.substr(0, slash);
+		name = slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	void FileWatcher::run() {
+		int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		// Watch the directories rather than the files, whose inodes change when an editor replaces them
+		std::vector<int> watches;
+		std::vector<std::string> names;
+		for (const std::string& path : paths) {
+			std::string directory, name;
+			split_path(path, directory, name);
+			watches.push_back(inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE));
+			names.push_back(name);
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		while (!stop) {
+			// Wake periodically to notice stop
+			pollfd p = { fd, POLLIN, 0 };
+			if (poll(&p, 1, 100) <= 0)
+				continue;
+
+			bool changed = false;
+			ssize_t length;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+				for (ssize_t offset = 0; offset < length;) {
+					const inotify_event* event = (const inotify_event*)(buffer + offset);
+					for (size_t i = 0; i < watches.size() && event->len > 0; i++) {
+						if (event->wd == watches[i] && names[i] == event->name)
+							changed = true;
+					}
+					offset += sizeof(inotify_event) + event->len;
+				}
+			}
+
+			// Let the rest of the save land, then drop its events
+			if (changed) {
+				std::this_thread::sleep_for(settle_time);
+				while (read(fd, buffer, sizeof(buffer)) > 0) {}
+				on_change();
+			}
+		}
+
+		close(fd);
+	}
+#else
+	static long long modified_time(const std::string& path) {
+#ifdef _WIN32
+		struct _stat64 info;
+		return _stat64(path.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+#else
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : -1;
+#endif
+	}
+
+	void FileWatcher::run() {
+		std::vector<long long> times;
+		for (const std::string& path : paths)
+			times.push_back(modified_time(path));
+
+		while (!stop) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+			bool changed = false;
+			for (size_t i = 0; i < paths.size(); i++) {
+				long long time = modified_time(paths[i]);
+				if (time != times[i]) {
+					times[i] = time;
+					changed = true;
+				}
+			}
+
+			if (changed) {
+				std::this_thread::sleep_for(settle_time);
+				on_change();
+			}
+		}
+	}
+#endif
+}
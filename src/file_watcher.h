@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+	// Calls on_change from a background thread shortly after any of the files
+	// is written or replaced. Uses inotify on Linux, so editors that save by
+	// renaming a new file over the old one are seen too; elsewhere the files'
+	// modification times are polled.
+	class FileWatcher {
+	public:
+		FileWatcher(const std::vector<std::string>& paths, std::function<void()> on_change);
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator = (const FileWatcher&) = delete;
+
+	private:
+		void run();
+
+		std::vector<std::string> paths;
+		std::function<void()> on_change;
+		std::atomic<bool> stop;
+		std::thread thread;
+	};
+}
@@ -0,0 +1,61 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace utils {
+	FrameArena::FrameArena(size_t capacity) :
+		capacity(capacity),
+		used(0),
+		high_water(0),
+		overflows(0),
+		block(new char[capacity]),
+		offset(0)
+	{
+		// Room for a few overflow blocks without the list itself growing mid-frame
+		overflow.reserve(16);
+	}
+
+	void* FrameArena::bump(char* base, size_t size, size_t& at, size_t bytes, size_t alignment) {
+		uintptr_t start = (uintptr_t)(base + at);
+		uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		size_t end = (size_t)(aligned - (uintptr_t)base) + bytes;
+		if (end > size)
+			return nullptr;
+		used += end - at;
+		at = end;
+		return (void*)aligned;
+	}
+
+	void* FrameArena::allocate(size_t size, size_t alignment) {
+		if (void* p = bump(block.get(), capacity, offset, size, alignment))
+			return p;
+
+		if (!overflow.empty()) {
+			Overflow& last = overflow.back();
+			if (void* p = bump(last.data.get(), last.size, last.offset, size, alignment))
+				return p;
+		}
+
+		// Out of room: borrow a block at least as big as everything so far, so overflows stay rare
+		overflows++;
+		const size_t block_size = std::max(size + alignment, capacity);
+		overflow.push_back(Overflow{ std::unique_ptr<char[]>(new char[block_size]), block_size, 0 });
+		Overflow& last = overflow.back();
+		return bump(last.data.get(), last.size, last.offset, size, alignment);
+	}
+
+	void FrameArena::reset() {
+		high_water = std::max(high_water, used);
+
+		// Grow once to what this frame needed, rather than overflowing every frame
+		if (!overflow.empty()) {
+			overflow.clear();
+			capacity = std::max(capacity * 2, high_water + high_water / 4);
+			block.reset(new char[capacity]);
+		}
+
+		offset = 0;
+		used = 0;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace utils {
+	// Bump allocator for data that lives for one frame. allocate() only moves an
+	// offset and reset() at the end of the frame releases everything at once.
+	// A frame that outgrows the block borrows extra blocks from the heap; reset()
+	// then replaces the block with one large enough, so a steady frame loop stops
+	// touching the heap after its first few frames.
+	class FrameArena {
+	public:
+		explicit FrameArena(size_t capacity);
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator = (const FrameArena&) = delete;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		void reset();
+
+		size_t capacity;
+
+		// Bytes handed out this frame, and the most any frame has needed
+		size_t used;
+		size_t high_water;
+
+		// Allocations that did not fit the block and went to the heap
+		unsigned int overflows;
+
+	private:
+		void* bump(char* base, size_t size, size_t& offset, size_t bytes, size_t alignment);
+
+		std::unique_ptr<char[]> block;
+		size_t offset;
+
+		struct Overflow {
+			std::unique_ptr<char[]> data;
+			size_t size;
+			size_t offset;
+		};
+		std::vector<Overflow> overflow;
+	};
+
+	// STL allocator over a FrameArena; deallocation is a no-op until the arena resets
+	template <typename T>
+	struct ArenaAllocator {
+		typedef T value_type;
+
+		explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(size_t n) { return (T*)arena->allocate(n * sizeof(T), alignof(T)); }
+		void deallocate(T*, size_t) {}
+
+		FrameArena* arena;
+	};
+
+	template <typename T, typename U>
+	bool operator == (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+
+	template <typename T, typename U>
+	bool operator != (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+	// Containers that must not outlive the frame they were made in
+	template <typename T>
+	using frame_vector = std::vector<T, ArenaAllocator<T>>;
+
+	typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> frame_string;
+}
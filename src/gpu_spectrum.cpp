@@ -0,0 +1,264 @@
+#include "gpu_spectrum.h"
+
+#include <algorithm>
+#include <cmath>
+
+static GLuint create_storage(GLsizeiptr size, const void* data) {
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return buffer;
+}
+
+bool GpuSpectrum::supported(int fft_size) {
+	return (GLEW_VERSION_4_3 || GLEW_ARB_compute_shader) && fft_size >= dsp::FFT::min_size && fft_size <= max_fft_size;
+}
+
+GpuSpectrum::GpuSpectrum(int fft_size, dsp::Window window, float kaiser_beta, const dsp::BandMap& map, float scale,
+	const dsp::DynamicsSettings& settings, int queue_frames) :
+	fft_size(fft_size),
+	num_bins(fft_size / 2),
+	num_bars(map.num_bands),
+	dropped_frames(0),
+	verify(false),
+	max_error(0.f),
+	fft_shader("shaders/c.spectrum_fft.glsl"),
+	bars_shader("shaders/c.spectrum_bars.glsl"),
+	log2_half(0),
+	ring_frames(queue_frames + 2),
+	zero_slot(queue_frames + 2),
+	next_slot(0),
+	staged((size_t)(queue_frames + 2) * fft_size),
+	staged_count(0),
+	staged_first_slot(0),
+	queued(queue_frames + 2),
+	queued_head(0),
+	queued_count(0),
+	previous{ 0, 0.0 },
+	has_previous(false),
+	current(0),
+	dynamics(map.num_bands, scale, settings),
+	cpu_fft(fft_size, window, kaiser_beta),
+	cpu_kernel(map, 1.f),
+	cpu_frames((size_t)(queue_frames + 3) * (fft_size / 2), 0.f),
+	cpu_spectrum(fft_size / 2),
+	cpu_levels(map.num_bands),
+	cpu_bars(map.num_bands),
+	gpu_bars(map.num_bands)
+{
+	u_size = fft_shader.uniform("size");
+	u_log2_half = fft_shader.uniform("log2_half");
+	u_first_slot = fft_shader.uniform("first_slot");
+	u_ring_frames = fft_shader.uniform("ring_frames");
+
+	u_mode = bars_shader.uniform("mode");
+	u_num_bars = bars_shader.uniform("num_bars");
+	u_fft_samples = bars_shader.uniform("fft_samples");
+	u_current = bars_shader.uniform("current");
+	u_frame_a = bars_shader.uniform("frame_a");
+	u_frame_b = bars_shader.uniform("frame_b");
+	u_frame_t = bars_shader.uniform("frame_t");
+	u_attack_k = bars_shader.uniform("attack_k");
+	u_release_k = bars_shader.uniform("release_k");
+	u_dt = bars_shader.uniform("dt");
+	u_peak_hold = bars_shader.uniform("peak_hold");
+	u_peak_gravity = bars_shader.uniform("peak_gravity");
+	u_blend = bars_shader.uniform("blend");
+	u_scale = bars_shader.uniform("scale");
+	u_bars_first = bars_shader.uniform("bars_first");
+	u_peaks_first = bars_shader.uniform("peaks_first");
+
+	// Window, butterfly twiddles and unpack factors, built exactly as dsp::FFT builds them
+	const int half = num_bins;
+	const double tau = 6.283185307179586;
+	std::vector<float> tables((size_t)fft_size + 4 * half, 0.f);
+	dsp::make_window(window, fft_size, kaiser_beta, tables.data());
+	for (int h = 1; h < half; h <<= 1) {
+		for (int j = 0; j < h; j++) {
+			double a = -tau * j / (2 * h);
+			tables[fft_size + h - 1 + j] = (float)cos(a);
+			tables[fft_size + half + h - 1 + j] = (float)sin(a);
+		}
+	}
+	for (int k = 0; k < half; k++) {
+		double a = -tau * k / fft_size;
+		tables[fft_size + 2 * half + k] = (float)cos(a);
+		tables[fft_size + 3 * half + k] = (float)sin(a);
+	}
+
+	std::vector<int> band_index;
+	band_index.insert(band_index.end(), map.start.begin(), map.start.end());
+	band_index.insert(band_index.end(), map.count.begin(), map.count.end());
+	band_index.insert(band_index.end(), map.offset.begin(), map.offset.end());
+
+	std::vector<float> frames((size_t)(ring_frames + 1) * half, 0.f);
+	std::vector<float> state((size_t)6 * num_bars, 0.f);
+
+	windows_buffer = create_storage(staged.size() * sizeof(float), nullptr);
+	tables_buffer = create_storage(tables.size() * sizeof(float), tables.data());
+	frames_buffer = create_storage(frames.size() * sizeof(float), frames.data());
+	band_index_buffer = create_storage(band_index.size() * sizeof(int), band_index.data());
+	band_weights_buffer = create_storage(std::max<size_t>(1, map.weights.size()) * sizeof(float), map.weights.data());
+	state_buffer = create_storage(state.size() * sizeof(float), state.data());
+
+	while ((1 << log2_half) < half)
+		log2_half++;
+}
+
+void GpuSpectrum::set_bars_uniforms() {
+	bars_shader.set_uniform(u_num_bars, num_bars);
+	bars_shader.set_uniform(u_fft_samples, num_bins);
+	bars_shader.set_uniform(u_attack_k, dynamics.attack_k);
+	bars_shader.set_uniform(u_release_k, dynamics.release_k);
+	bars_shader.set_uniform(u_dt, (float)dynamics.dt);
+	bars_shader.set_uniform(u_peak_hold, dynamics.settings.peak_hold);
+	bars_shader.set_uniform(u_peak_gravity, dynamics.settings.peak_gravity);
+	bars_shader.set_uniform(u_scale, dynamics.scale);
+}
+
+void GpuSpectrum::push(const float* samples, double time) {
+	// previous and every queued frame must keep their slots until consumed
+	if (queued_count + 1 >= ring_frames) {
+		dropped_frames++;
+		return;
+	}
+
+	if (staged_count == 0)
+		staged_first_slot = next_slot;
+	std::copy(samples, samples + fft_size, staged.begin() + (size_t)staged_count * fft_size);
+	staged_count++;
+
+	if (verify)
+		cpu_fft.magnitudes(samples, &cpu_frames[(size_t)next_slot * num_bins]);
+
+	queued[(queued_head + queued_count) % ring_frames] = QueuedFrame{ next_slot, time };
+	queued_count++;
+	next_slot = (next_slot + 1) % ring_frames;
+}
+
+void GpuSpectrum::transform_windows() {
+	if (staged_count == 0)
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, windows_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)staged_count * fft_size * sizeof(float), staged.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, windows_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tables_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, frames_buffer);
+
+	fft_shader.use();
+	fft_shader.set_uniform(u_size, fft_size);
+	fft_shader.set_uniform(u_log2_half, log2_half);
+	fft_shader.set_uniform(u_ring_frames, ring_frames);
+	fft_shader.set_uniform(u_first_slot, staged_first_slot);
+	glDispatchCompute(staged_count, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	staged_count = 0;
+}
+
+void GpuSpectrum::advance(double time) {
+	transform_windows();
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, frames_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, band_index_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, band_weights_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, state_buffer);
+
+	bars_shader.use();
+	set_bars_uniforms();
+	bars_shader.set_uniform(u_mode, 0);
+
+	while (dynamics.due(time)) {
+		const double step_time = dynamics.step_time();
+
+		// Same choice as STFT::sample: the newest frame at or before the step and the one after it
+		while (queued_count > 0 && queued[queued_head].time <= step_time) {
+			previous = queued[queued_head];
+			has_previous = true;
+			queued_head = (queued_head + 1) % ring_frames;
+			queued_count--;
+		}
+
+		int a = zero_slot, b = zero_slot;
+		float t = 0.f;
+		if (has_previous) {
+			a = b = previous.slot;
+			const QueuedFrame* next = queued_count > 0 ? &queued[queued_head] : nullptr;
+			if (next && next->time > previous.time) {
+				b = next->slot;
+				t = (float)std::min(1.0, std::max(0.0, (step_time - previous.time) / (next->time - previous.time)));
+			}
+		}
+
+		bars_shader.set_uniform(u_frame_a, a);
+		bars_shader.set_uniform(u_frame_b, b);
+		bars_shader.set_uniform(u_frame_t, t);
+		bars_shader.set_uniform(u_current, current);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		current = 1 - current;
+
+		if (verify) {
+			const float* fa = &cpu_frames[(size_t)a * num_bins];
+			const float* fb = &cpu_frames[(size_t)b * num_bins];
+			for (int i = 0; i < num_bins; i++)
+				cpu_spectrum[i] = fa[i] + (fb[i] - fa[i]) * t;
+			cpu_kernel.levels(cpu_spectrum.data(), cpu_levels.data());
+			dynamics.step(cpu_levels.data());
+		}
+		else {
+			dynamics.skip();
+		}
+	}
+
+	bars_shader.release();
+}
+
+void GpuSpectrum::output(double time, BarRenderer& bars, BarRenderer& peaks) {
+	GLint bars_first, peaks_first;
+	const GLuint bars_buffer = bars.next_instances(bars_first);
+	const GLuint peaks_buffer = peaks.next_instances(peaks_first);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, state_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, bars_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, peaks_buffer);
+
+	bars_shader.use();
+	set_bars_uniforms();
+	bars_shader.set_uniform(u_mode, 1);
+	bars_shader.set_uniform(u_current, current);
+	bars_shader.set_uniform(u_blend, dynamics.blend(time));
+	bars_shader.set_uniform(u_bars_first, bars_first);
+	bars_shader.set_uniform(u_peaks_first, peaks_first);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	bars_shader.release();
+
+	if (!verify)
+		return;
+
+	// Bars, then peaks
+	for (int pass = 0; pass < 2; pass++) {
+		dynamics.interpolate(time, pass == 0 ? cpu_bars.data() : nullptr, pass == 1 ? cpu_bars.data() : nullptr);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, pass == 0 ? bars_buffer : peaks_buffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)(pass == 0 ? bars_first : peaks_first) * sizeof(float),
+			num_bars * sizeof(float), gpu_bars.data());
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		for (int i = 0; i < num_bars; i++)
+			max_error = std::max(max_error, fabsf(gpu_bars[i] - cpu_bars[i]));
+	}
+}
+
+void GpuSpectrum::destroy() {
+	GLuint buffers[] = { windows_buffer, tables_buffer, frames_buffer, band_index_buffer, band_weights_buffer, state_buffer };
+	glDeleteBuffers(6, buffers);
+	fft_shader.destroy();
+	bars_shader.destroy();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <vector>
+
+#include "band_map.h"
+#include "bar_dynamics.h"
+#include "bar_renderer.h"
+#include "fft.h"
+#include "shader.h"
+#include "spectrum.h"
+
+// The live spectrum path on the GPU. Raw PCM windows from an STFT without a
+// transform are uploaded to a storage buffer; shaders/c.spectrum_fft.glsl turns
+// them into a ring of magnitude frames and shaders/c.spectrum_bars.glsl steps
+// the bar dynamics on them and writes bar and peak lengths straight into the
+// renderers' instance buffers. Frame selection and the step clock run on the
+// CPU exactly as STFT::sample and BarDynamics do, so both paths draw the same bars.
+class GpuSpectrum {
+public:
+	// Both halves of the packed window must fit the 32 KB of shared memory GL guarantees
+	static const int max_fft_size = 4096;
+	static const int max_fft_samples = 2048;
+
+	// Compute shaders (GL 4.3) and an FFT size the transform can hold
+	static bool supported(int fft_size);
+
+	GpuSpectrum(int fft_size, dsp::Window window, float kaiser_beta, const dsp::BandMap& map, float scale,
+		const dsp::DynamicsSettings& settings = dsp::DynamicsSettings(), int queue_frames = 64);
+
+	// Queue the fft_size mono samples of the STFT frame at time
+	void push(const float* samples, double time);
+
+	// Transform the queued windows and step the dynamics up to time
+	void advance(double time);
+
+	// Write bar and peak lengths at time into the renderers' next instance segments
+	void output(double time, BarRenderer& bars, BarRenderer& peaks);
+
+	void destroy();
+
+	int fft_size;
+	int num_bins;
+	int num_bars;
+
+	// Windows lost because more arrived than the frame ring holds
+	unsigned int dropped_frames;
+
+	// Mirror every step on the CPU (FFT, BinKernel, BarDynamics) and compare
+	// each output() with it. For parity checks only: it reads the GPU back.
+	bool verify;
+
+	// Largest difference between a GPU and CPU bar or peak length seen while verifying
+	float max_error;
+
+private:
+	struct QueuedFrame {
+		int slot;
+		double time;
+	};
+
+	void transform_windows();
+
+	// Uniforms are set on every dispatch, as the renderers set theirs on every
+	// draw, so a hot-reloaded program never runs with them unset
+	void set_bars_uniforms();
+
+	utils::Shader fft_shader;
+	utils::Shader bars_shader;
+
+	utils::Uniform u_size;
+	utils::Uniform u_log2_half;
+	utils::Uniform u_first_slot;
+	utils::Uniform u_ring_frames;
+
+	utils::Uniform u_mode;
+	utils::Uniform u_num_bars;
+	utils::Uniform u_fft_samples;
+	utils::Uniform u_current;
+	utils::Uniform u_frame_a;
+	utils::Uniform u_frame_b;
+	utils::Uniform u_frame_t;
+	utils::Uniform u_attack_k;
+	utils::Uniform u_release_k;
+	utils::Uniform u_dt;
+	utils::Uniform u_peak_hold;
+	utils::Uniform u_peak_gravity;
+	utils::Uniform u_blend;
+	utils::Uniform u_scale;
+	utils::Uniform u_bars_first;
+	utils::Uniform u_peaks_first;
+
+	GLuint windows_buffer;
+	GLuint tables_buffer;
+	GLuint frames_buffer;
+	GLuint band_index_buffer;
+	GLuint band_weights_buffer;
+	GLuint state_buffer;
+
+	int log2_half;
+
+	// Magnitude frame slots, the last always zero for steps before the first frame
+	int ring_frames;
+	int zero_slot;
+	int next_slot;
+
+	// Windows waiting for transform_windows()
+	std::vector<float> staged;
+	int staged_count;
+	int staged_first_slot;
+
+	// Transformed frames after previous, oldest first
+	std::vector<QueuedFrame> queued;
+	int queued_head;
+	int queued_count;
+
+	QueuedFrame previous;
+	bool has_previous;
+
+	// Which half of the state buffer holds the newest step
+	int current;
+
+	dsp::BarDynamics dynamics;
+
+	// CPU mirror for verify
+	dsp::FFT cpu_fft;
+	dsp::BinKernel cpu_kernel;
+	std::vector<float> cpu_frames;
+	std::vector<float> cpu_spectrum;
+	std::vector<float> cpu_levels;
+	std::vector<float> cpu_bars;
+	std::vector<float> gpu_bars;
+};
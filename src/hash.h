@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+	const uint64_t fnv1a_seed = 14695981039346656037ULL;
+
+	// 64-bit FNV-1a, chain calls by passing the previous result as hash
+	inline uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= p[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+}
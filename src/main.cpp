@@ -1,28 +1,40 @@
 #include <GL\glew.h>
 #include <GLFW\glfw3.h>
 #include <bass.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <cstdio>
-
-#include "camera.h"
-#include "shader.h"
-
-const int FFT_SAMPLES = 1024;
-const int RES_X = 800;
-const int RES_Y = 600;
-const int NUM_BINS = 512;
-
-const float NUM_BINSf = (float)NUM_BINS;
-const float FFT_SAMPLESf = (float)FFT_SAMPLES;
-const float RES_Xf = (float)RES_X;
-const float RES_Yf = (float)RES_Y;
-const float FFT_SCALEf = 5.f * RES_Xf;
-const float	FFT_SAMPLE_RANGEf = FFT_SAMPLESf / NUM_BINSf;
-const float bin_heightf = (RES_Yf / NUM_BINSf);
-const float bin_distancef = 1.5;
-const float bin_pos_xf = RES_Xf * 0.5f;
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "alloc_counter.h"
+#include "audio_features.h"
+#include "bar_dynamics.h"
+#include "bar_renderer.h"
+#include "bass_decoder.h"
+#include "config.h"
+#include "frame_arena.h"
+#include "gpu_spectrum.h"
+#include "offline.h"
+#include "point_bar_renderer.h"
+#include "profiler.h"
+#include "spectrum.h"
+#include "spectrogram_renderer.h"
+#include "spectrum_cache.h"
+#include "stft.h"
+#include "utils.h"
+
+// Frames run before the loop is expected to stop touching the heap
+constexpr int WARMUP_FRAMES = 120;
+
+// Read when no --config is given, if it exists
+const char* default_config = "visualiser.cfg";
 
 const char* title = "demo";
-const char* tune = "music/Rolemusic_-_pl4y1ng.mp3";
 
 static void exit_error(const char* fmt, ...) 
 {
@@ -37,7 +49,7 @@ static void exit_error(const char* fmt, ...)
 	exit(EXIT_FAILURE);
 }
 
-GLFWwindow* glfw_init()
+GLFWwindow* glfw_init(const Config& config)
 {
 	// Check lib initialised successfully
 	if (!glfwInit())
@@ -49,9 +61,9 @@ GLFWwindow* glfw_init()
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 
-	// Create the window
-	int count;
-	GLFWwindow* window = glfwCreateWindow(RES_X, RES_Y, title, NULL, NULL);
+	// Create the window, fullscreen at the configured resolution on the primary monitor
+	GLFWmonitor* monitor = config.fullscreen ? glfwGetPrimaryMonitor() : NULL;
+	GLFWwindow* window = glfwCreateWindow(config.width, config.height, title, monitor, NULL);
 	
 	// Check window creation successful
 	if (!window) {
@@ -61,6 +73,7 @@ GLFWwindow* glfw_init()
 
 	// Make window context active
 	glfwMakeContextCurrent(window);
+	glfwSwapInterval(config.vsync ? 1 : 0);
 
 	return window;
 }
@@ -74,16 +87,22 @@ void glew_init()
 		exit_error("Glew failed to initialise");
 }
 
-HSTREAM bass_init() 
+void bass_init() 
 {
 	if (!BASS_Init(-1, 44100, 0, 0, 0))
 		exit_error("Bass failed to initialise");
-	
-	HSTREAM stream;
-	stream = BASS_StreamCreateFile(false, tune, 0, 0, BASS_STREAM_PRESCAN);
+
+	// Formats without a native reader fall back to BASS
+	dsp::register_decoder(&dsp::BassDecoder::open);
+}
+
+// The tune is decoded in chunks as playback needs them, so startup does not depend on its length
+HSTREAM bass_play(dsp::Decoder* decoder) 
+{
+	HSTREAM stream = dsp::create_playback_stream(decoder);
 	
 	if (!stream)
-		exit_error("Bass failed to open tune");
+		exit_error("Bass failed to create the playback stream");
 	
 	BASS_Start();
 	BASS_ChannelPlay(stream, false);
@@ -91,103 +110,340 @@ HSTREAM bass_init()
 	return stream;
 }
 
+// Value following a "--name" argument, or nullptr if it was not given
+static const char* find_arg(int argc, char* argv[], const char* name)
+{
+	for (int i = 1; i < argc - 1; i++)
+		if (strcmp(argv[i], name) == 0)
+			return argv[i + 1];
+	return nullptr;
+}
+
+static bool has_arg(int argc, char* argv[], const char* name)
+{
+	for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return true;
+	return false;
+}
+
+static std::unique_ptr<BarBackend> create_bars(bool points, int num_bins, float bin_height, float bin_pos_x)
+{
+	if (points)
+		return std::unique_ptr<BarBackend>(new PointBarRenderer{ num_bins, bin_height, bin_pos_x });
+	return std::unique_ptr<BarBackend>(new BarRenderer{ num_bins, bin_height, bin_pos_x });
+}
+
 int main(int argc, char* argv[])
 {
+	// Settings file, then "--key value" overrides: --config <file> --tune <path> --fft-size <n>
+	// --bands <n> --resolution <WxH> --fullscreen <on|off> --vsync <on|off> --frame-cap <fps>
+	// --analysis-threads <n>; see config.h for the rest
+	Config config;
+	const char* config_file = find_arg(argc, argv, "--config");
+	if (!config.load(config_file ? config_file : default_config, config_file != nullptr) || !config.parse_args(argc, argv))
+		exit_error("Invalid configuration");
+	if (const char* problem = config.validate()) {
+		fprintf(stderr, "*** Config Error: %s\n", problem);
+		exit_error("Invalid configuration");
+	}
+
+	// Everything sized from the config is sized here, once
+	utils::config::resolution = maths::vec2{ (float)config.width, (float)config.height };
+	utils::config::fullscreen = config.fullscreen;
+	const maths::vec2 resolution = utils::config::resolution;
+	const int fft_samples = config.fft_size / 2;
+	const int num_bins = config.num_bins;
+	const float fft_scale = 5.f * resolution.x;
+	const float bin_height = resolution.y / (float)num_bins;
+	const float bin_pos_x = resolution.x * 0.5f;
+	const maths::mat4 projection = maths::orthographic_matrix(resolution, -1.f, 1.f, maths::mat4());
+	const char* tune = config.tune.c_str();
+
+	// Headless batch rendering: --offline <dir|-> [--fps <n>]
+	if (const char* output = find_arg(argc, argv, "--offline")) {
+		OfflineSettings settings{ tune, output, 60, config.width, config.height, config.fft_size, config.hop_size,
+			config.window, config.kaiser_beta, num_bins, config.band_scale, fft_scale };
+		if (const char* fps = find_arg(argc, argv, "--fps"))
+			settings.fps = std::max(1, atoi(fps));
+		return render_offline(settings);
+	}
+
+	// Chrome trace JSON of the frame stages, written on exit: --trace <file>
+	const char* trace_file = find_arg(argc, argv, "--trace");
+
+	// Rebuild shaders whenever their source files are saved: --watch-shaders
+	utils::Shader::hot_reload = has_arg(argc, argv, "--watch-shaders");
+
+	// Transform and step the bars in compute shaders: --gpu-spectrum [--gpu-verify]
+	const bool want_gpu_spectrum = has_arg(argc, argv, "--gpu-spectrum");
+
+	// Bar drawing backend: --bars instanced (default) | points
+	const char* bars_backend = find_arg(argc, argv, "--bars");
+	bool point_bars = bars_backend && strcmp(bars_backend, "points") == 0;
+
+	// Scrolling history of every dynamics step's band levels instead of the bars: --spectrogram
+	const bool spectrogram_mode = has_arg(argc, argv, "--spectrogram");
+
 	// Init external libraries
-	GLFWwindow* window = glfw_init();
+	GLFWwindow* window = glfw_init(config);
 	glew_init();
-	HSTREAM stream = bass_init();
+	bass_init();
+
+	std::unique_ptr<dsp::Decoder> decoder = dsp::open_decoder(tune);
+	if (!decoder)
+		exit_error("Failed to open tune");
+
+	dsp::BandMap band_map{ config.band_scale, fft_samples, num_bins, (float)decoder->sample_rate };
+	dsp::BinKernel bin_kernel{ band_map, fft_scale };
+
+	// Tracks analysed on an earlier run replay their band levels from disk by playback time
+	const std::string cache_path = std::string(tune) + ".spectrum";
+	const uint64_t source_hash = dsp::source_fingerprint(tune);
+	dsp::SpectrumCache cache{ cache_path.c_str(), source_hash, config.fft_size, config.hop_size, config.window, config.kaiser_beta, band_map };
+
+	// Live analysis may run on the GPU, when it can; the STFT then only cuts the windows
+	// The spectrogram is fed the CPU's band levels, which the compute path never produces
+	const bool use_gpu_spectrum = want_gpu_spectrum && !spectrogram_mode && !cache.is_open() && GpuSpectrum::supported(config.fft_size);
+	if (want_gpu_spectrum && !use_gpu_spectrum)
+		fprintf(stderr, "GPU spectrum unavailable, using the CPU path\n");
+
+	// The compute path writes bar lengths into instance buffers, which only the instanced backend reads
+	if (use_gpu_spectrum && point_bars) {
+		fprintf(stderr, "GPU spectrum draws instanced bars, ignoring --bars points\n");
+		point_bars = false;
+	}
+
+	// Otherwise the STFT sees every sample on its way to playback, one spectrum
+	// every hop_size samples, while a second decoder builds the cache for next time
+	dsp::STFT stft{ config.fft_size, config.hop_size, (float)decoder->sample_rate, config.window, config.kaiser_beta, 64, !use_gpu_spectrum };
+	// Loudness, onsets and beats are always analysed on the way to playback, cached or not
+	dsp::FeatureAnalyser features{ (float)decoder->sample_rate };
+	dsp::AnalysisTap analysis_tap{ *decoder, cache.is_open() ? nullptr : &stft, &features };
+	std::atomic<bool> cancel_cache{ false };
+	std::thread cache_writer;
+
+	if (!cache.is_open()) {
+		cache_writer = std::thread([&] {
+			std::unique_ptr<dsp::Decoder> cache_decoder = dsp::open_decoder(tune);
+			if (cache_decoder)
+				dsp::write_spectrum_cache(cache_path.c_str(), *cache_decoder, config.fft_size, config.hop_size, config.window, config.kaiser_beta,
+					band_map, source_hash, &cancel_cache, config.analysis_threads);
+		});
+	}
+
+	HSTREAM stream = bass_play(&analysis_tap);
 	
-	// Init OpenGL data
-	GLuint vao, vbo;
-	Shader shader_2D{ "shaders/v.uniform_MP.glsl", "shaders/f.uniform_colour.glsl" };
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(mesh::quad_points_textured), &mesh::quad_points_textured, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-
-	// Init the camera
-	Camera cam({ RES_Xf, RES_Yf });
-
-	// Init Bin arrays
-	float oldbins[NUM_BINS] = { 0.f };
-	float bins[NUM_BINS] = { 0.f };
+	// Init OpenGL data, peaks are drawn first as grey bars behind the levels
+	std::unique_ptr<BarBackend> bar_renderer = create_bars(point_bars, num_bins, bin_height, bin_pos_x);
+	std::unique_ptr<BarBackend> peak_renderer = create_bars(point_bars, num_bins, bin_height, bin_pos_x);
+	peak_renderer->colour_quiet = utils::colour::dark_grey;
+	peak_renderer->colour_loud = utils::colour::grey;
+
+	std::unique_ptr<SpectrogramRenderer> spectrogram;
+	if (spectrogram_mode && !SpectrogramRenderer::fits(num_bins, config.spectrogram_history)) {
+		fprintf(stderr, "*** Config Error: a %d x %d spectrogram exceeds the texture limits\n", num_bins, config.spectrogram_history);
+		exit_error("Invalid configuration");
+	}
+	if (spectrogram_mode)
+		spectrogram.reset(new SpectrogramRenderer{ num_bins, config.spectrogram_history, maths::vec4{ 0.f, 0.f, resolution.x, resolution.y } });
 
+	// Bar dynamics run on a fixed timestep of the playback clock, whatever the frame rate
+	dsp::BarDynamics dynamics{ num_bins, fft_scale };
+
+	// Everything that lives for one frame comes from here and is released at its end
+	utils::FrameArena frame_arena{ 64 * 1024 };
+	unsigned int frame_index = 0;
+	unsigned int allocating_frames = 0;
+
+	std::unique_ptr<GpuSpectrum> gpu_spectrum;
+	if (use_gpu_spectrum) {
+		gpu_spectrum.reset(new GpuSpectrum{ config.fft_size, config.window, config.kaiser_beta, band_map, fft_scale });
+		gpu_spectrum->verify = has_arg(argc, argv, "--gpu-verify");
+	}
+
+	// Frame stage timings, summarised in the window title once a second
+	utils::Profiler profiler{ GLEW_ARB_timer_query != 0 };
+	const int stage_frame = profiler.stage("frame");
+	const int stage_fetch = profiler.stage("fetch");
+	const int stage_post = profiler.stage("post");
+	const int stage_upload = profiler.stage("upload");
+	const int stage_draw = profiler.stage("draw");
+	const int stage_swap = profiler.stage("swap");
+	char title_stats[512];
+	float next_title_update = 1.f;
+
+	// Frames are paced to frame_cap by sleeping until each one's deadline
+	const double frame_period = config.frame_cap > 0 ? 1.0 / config.frame_cap : 0.0;
+	double next_frame = glfwGetTime();
+
+	// Beats flash the background, fading over a fraction of a second
+	float beat_flash = 0.f;
+	double last_frame_time = 0.0;
+	dsp::FeatureFrame feature_frame{};
 
 	while (!glfwWindowShouldClose(window)) {
+		profiler.begin(stage_frame);
+		utils::Shader::string_lookups = 0;
+		const unsigned long long heap_allocations = utils::heap_allocations();
+
+		// Spectrum resampled from the STFT at the playback position, or cached levels,
+		// and the bar and peak lengths drawn this frame
+		utils::ArenaAllocator<float> frame_floats{ frame_arena };
+		utils::frame_vector<float> spectrum(stft.num_bins, 0.f, frame_floats);
+		utils::frame_vector<float> levels(band_map.num_bands, 0.f, frame_floats);
+		utils::frame_vector<float> bins(band_map.num_bands, 0.f, frame_floats);
+		utils::frame_vector<float> peaks(band_map.num_bands, 0.f, frame_floats);
+
+		// Step the dynamics up to what is being heard right now, each step fed the
+		// levels at its own time; decoding runs ahead of playback, so the STFT
+		// frames either side of it are normally both queued
+		double playback_time = BASS_ChannelBytes2Seconds(stream, BASS_ChannelGetPosition(stream, BASS_POS_BYTE));
+
+		// Events are handed over as playback reaches them, so they land with what is heard
+		beat_flash *= expf(-(float)std::max(0.0, playback_time - last_frame_time) / 0.15f);
+		last_frame_time = playback_time;
+		dsp::FeatureEvent event;
+		while (features.poll(playback_time, event)) {
+			if (event.type == dsp::FeatureEventType::beat)
+				beat_flash = 1.f;
+		}
+		features.frame_at(playback_time, feature_frame);
+
+		glClearColor(0.2f * beat_flash, 0.2f * beat_flash, 0.25f * beat_flash, 1.f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Get the FFT
-		float fft[FFT_SAMPLES];
-		BASS_ChannelGetData(stream, fft, BASS_DATA_FFT2048);
-                for (int i = 0; i < FFT_SAMPLES; i++)
-                        fft[i] = sqrt(fft[i]);
-
-                // Normalise FFT values for consistent scaling
-                float max_fft = 0.f;
-                for (int i = 0; i < FFT_SAMPLES; i++)
-                        if (fft[i] > max_fft)
-                                max_fft = fft[i];
-                if (max_fft > 0.f)
-                        for (int i = 0; i < FFT_SAMPLES; i++)
-                                fft[i] = (fft[i] / max_fft) * FFT_SCALEf;
-
-		// Update the old bins
-		std::copy(bins, bins + NUM_BINS, oldbins);
-
-		// Update the new bins
-		for (int i = 0; i < NUM_BINS; i++) {
-			// Reset the bin array representing next FFT samples
-			bins[i] = 0.f;
-
-			// Get upper and lower values for FFT sampling
-			int lower = roundf(FFT_SAMPLE_RANGEf * (float)(i));
-			int upper = roundf(FFT_SAMPLE_RANGEf * (float)(i + 1));
-
-			// Average of FFT values is the new value for that bin
-                        for (int j = lower; j < upper; j++)
-                                bins[i] += fft[j];
-                        int sample_count = upper - lower;
-                        if (sample_count > 0)
-                                bins[i] /= static_cast<float>(sample_count);
-
-			// Average the new bin value with the previous value for smoother display
-			bins[i] = (bins[i] + oldbins[i]) * 0.5f;
-
-			// Draw quads representing each bin's intensity
-			float b = (bin_heightf * 0.5f) + (i * bin_heightf);
-			float relative_loudness = bins[i] / 400.f;
-			vec4 col = lerp(utils::colour::red, utils::colour::green, relative_loudness);
-
-			glBindVertexArray(vao);
-			shader_2D.use();
-			shader_2D.set_uniform("uniform_colour", col);
-			shader_2D.set_uniform("projection", cam.matrix_projection_ortho);
-			shader_2D.set_uniform("model", utils::gen_model_matrix({ bins[i], bin_heightf }, { bin_pos_xf, b }));
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-			glBindVertexArray(0);
-			shader_2D.release();
+		if (gpu_spectrum) {
+			{
+				utils::ScopedTimer timer{ profiler, stage_fetch };
+				while (dsp::SpectrumFrame* frame = stft.front()) {
+					gpu_spectrum->push(frame->samples.data(), frame->time);
+					stft.pop();
+				}
+			}
+			{
+				utils::ScopedTimer timer{ profiler, stage_post };
+				gpu_spectrum->advance(playback_time);
+			}
+		}
+		while (!gpu_spectrum && dynamics.due(playback_time)) {
+			{
+				utils::ScopedTimer timer{ profiler, stage_fetch };
+				if (cache.is_open())
+					cache.levels_at(dynamics.step_time(), levels.data());
+				else
+					stft.sample(dynamics.step_time(), spectrum.data());
+			}
+			{
+				utils::ScopedTimer timer{ profiler, stage_post };
+				if (!cache.is_open())
+					bin_kernel.levels(spectrum.data(), levels.data());
+				dynamics.step(levels.data());
+				if (spectrogram)
+					spectrogram->push(levels.data());
+			}
+		}
+		if (!gpu_spectrum)
+			dynamics.interpolate(playback_time, bins.data(), peaks.data());
+
+		// Draw quads representing each bin's intensity in one instanced call each
+		{
+			utils::ScopedTimer timer{ profiler, stage_upload };
+			if (spectrogram) {
+				spectrogram->upload();
+			}
+			else if (gpu_spectrum) {
+				gpu_spectrum->output(playback_time, static_cast<BarRenderer&>(*bar_renderer), static_cast<BarRenderer&>(*peak_renderer));
+			}
+			else {
+				peak_renderer->update(peaks.data());
+				bar_renderer->update(bins.data());
+			}
+		}
+		{
+			utils::ScopedTimer timer{ profiler, stage_draw };
+			profiler.begin_gpu(stage_draw);
+			if (spectrogram) {
+				spectrogram->draw(projection);
+			}
+			else {
+				peak_renderer->draw(projection);
+				bar_renderer->draw(projection);
+			}
+			profiler.end_gpu(stage_draw);
 		}
 
-		// Quit if the tune ended
-		if (BASS_ErrorGetCode() == BASS_ERROR_ENDED)
+		// Uniforms in the frame loop must go through pre-resolved handles
+		assert(utils::Shader::string_lookups == 0);
+
+		// Quit if the tune ended; BASS error codes are per thread, so ask the stream itself
+		if (BASS_ChannelIsActive(stream) == BASS_ACTIVE_STOPPED)
 			glfwSetWindowShouldClose(window, GLFW_TRUE);
 
-		glfwPollEvents();
-		glfwSwapBuffers(window);
+		{
+			utils::ScopedTimer timer{ profiler, stage_swap };
+			glfwPollEvents();
+			glfwSwapBuffers(window);
+		}
+
+		profiler.end(stage_frame);
+		profiler.end_frame();
+
+		if (frame_period > 0.0) {
+			next_frame += frame_period;
+			const double wait = next_frame - glfwGetTime();
+			if (wait > 0.0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+			else if (wait < -frame_period)
+				next_frame = glfwGetTime();	// Too far behind to catch up without a burst
+		}
+
+		if (utils::elapsed_time() >= next_title_update) {
+			utils::frame_string tempo = utils::friendly_float(frame_arena, feature_frame.tempo, 5);
+			utils::frame_string loudness = utils::friendly_float(frame_arena, feature_frame.short_term, 5);
+			int used = snprintf(title_stats, sizeof(title_stats), "%s | %s BPM %s LUFS | ms p50/p99 ",
+				title, tempo.c_str(), loudness.c_str());
+			profiler.summary(title_stats + used, sizeof(title_stats) - used);
+			glfwSetWindowTitle(window, title_stats);
+			next_title_update += 1.f;
+		}
+
+		frame_arena.reset();
+
+		// Once warmed up the loop must not touch the heap; per-frame data belongs in
+		// frame_arena. Only this thread is counted, so the decoding and cache threads
+		// may allocate freely. Rebuilding a hot-reloaded shader is the one allowed exception.
+		const bool allocated = utils::heap_allocations() != heap_allocations;
+		if (++frame_index > WARMUP_FRAMES && allocated)
+			allocating_frames++;
+		assert(frame_index <= WARMUP_FRAMES || !allocated || utils::Shader::hot_reload);
 	}
 
+	printf("Frames that allocated after warm-up: %u, frame arena high water %zu bytes\n", allocating_frames, frame_arena.high_water);
+
 	// Cleanup
-	glDeleteBuffers(1, &vbo);
-	glDeleteVertexArrays(1, &vao);
-	shader_2D.destroy();
+	cancel_cache = true;
+	if (cache_writer.joinable())
+		cache_writer.join();
+	if (gpu_spectrum) {
+		if (gpu_spectrum->verify)
+			printf("GPU spectrum max error vs CPU: %g\n", gpu_spectrum->max_error);
+		gpu_spectrum->destroy();
+	}
+	if (spectrogram)
+		spectrogram->destroy();
+	bar_renderer->destroy();
+	peak_renderer->destroy();
+
+	printf("Feature events: %u, latency from audio to delivery mean %.1f ms, max %.1f ms\n",
+		features.delivery_latency.count, features.delivery_latency.mean() * 1000.0, features.delivery_latency.max * 1000.0);
+
+	if (trace_file && !profiler.export_trace(trace_file))
+		fprintf(stderr, "*** Application Error: Failed to write trace %s\n", trace_file);
+	profiler.destroy();
 
 	BASS_StreamFree(stream);
+	decoder.reset();
 	BASS_Free();
 
 	glfwTerminate();
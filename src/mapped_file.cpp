@@ -0,0 +1,67 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+#ifdef _WIN32
+	MappedFile::MappedFile(const char* path) : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length) || length.QuadPart == 0)
+			return;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			return;
+
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data)
+			size = (size_t)length.QuadPart;
+	}
+
+	MappedFile::~MappedFile() {
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+#else
+	MappedFile::MappedFile(const char* path) : data(nullptr), size(0) {
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* p = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				// Decoding walks the file front to back
+				madvise(p, (size_t)info.st_size, MADV_SEQUENTIAL);
+				data = (const unsigned char*)p;
+				size = (size_t)info.st_size;
+			}
+		}
+
+		// The mapping keeps its own reference to the file
+		close(fd);
+	}
+
+	MappedFile::~MappedFile() {
+		if (data)
+			munmap((void*)data, size);
+	}
+#endif
+}
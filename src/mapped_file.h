@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace utils {
+	// Read-only memory mapping of a whole file. Pages are only faulted in as
+	// they are touched, so opening costs the same regardless of file length.
+	class MappedFile {
+	public:
+		explicit MappedFile(const char* path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator = (const MappedFile&) = delete;
+
+		bool is_open() const { return data != nullptr; }
+
+		const unsigned char* data;
+		size_t size;
+
+	private:
+#ifdef _WIN32
+		void* file;
+		void* mapping;
+#endif
+	};
+}
@@ -1,7 +1,49 @@
 #include "maths.h"
+#include "cpu.h"
+
+#include <cmath>
+
+#if defined(CPU_X86)
+#include <emmintrin.h>
+#elif defined(CPU_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace maths {
-	float PI = 3.14159265358979f;
+#if defined(CPU_X86)
+	static inline __m128 load(const vec4& v) { return _mm_loadu_ps(v.n); }
+	static inline void store(vec4& v, __m128 r) { _mm_storeu_ps(v.n, r); }
+
+	static inline float horizontal_sum(__m128 v) {
+		__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuf);
+		shuf = _mm_movehl_ps(shuf, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+	}
+
+	// Row i of a times b: a[i].x * b.x + a[i].y * b.y + a[i].z * b.z + a[i].w * b.w
+	static inline __m128 mult_row(const vec4& row, __m128 b0, __m128 b1, __m128 b2, __m128 b3) {
+		__m128 r = _mm_mul_ps(_mm_set1_ps(row.x), b0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row.y), b1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row.z), b2));
+		return _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(row.w), b3));
+	}
+#elif defined(CPU_NEON)
+	static inline float32x4_t load(const vec4& v) { return vld1q_f32(v.n); }
+	static inline void store(vec4& v, float32x4_t r) { vst1q_f32(v.n, r); }
+
+	static inline float horizontal_sum(float32x4_t v) {
+		float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+		return vget_lane_f32(vpadd_f32(s, s), 0);
+	}
+
+	static inline float32x4_t mult_row(const vec4& row, float32x4_t b0, float32x4_t b1, float32x4_t b2, float32x4_t b3) {
+		float32x4_t r = vmulq_n_f32(b0, row.x);
+		r = vmlaq_n_f32(r, b1, row.y);
+		r = vmlaq_n_f32(r, b2, row.z);
+		return vmlaq_n_f32(r, b3, row.w);
+	}
+#endif
 
 	vec2 polar_to_cartesian(float theta) {
 		float c = cos(theta);
@@ -13,16 +55,49 @@ namespace maths {
 		return atan2(v.y, v.x);
 	}
 
+	// The w component of v is treated as 1
 	vec4 mult(const mat4& m, const vec4& v) {
+#if defined(CPU_X86)
+		__m128 c0 = load(m.x), c1 = load(m.y), c2 = load(m.z), c3 = load(m.w);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+		__m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v.x)), c3);
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(v.y)));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(v.z)));
+
+		vec4 out;
+		store(out, r);
+		return out;
+#elif defined(CPU_NEON)
+		float32x4x4_t c = vld4q_f32(m.x.n);
+		float32x4_t r = vmlaq_n_f32(c.val[3], c.val[0], v.x);
+		r = vmlaq_n_f32(r, c.val[1], v.y);
+		r = vmlaq_n_f32(r, c.val[2], v.z);
+
+		vec4 out;
+		store(out, r);
+		return out;
+#else
 		float x = (m.x.x * v.x) + (m.x.y * v.y) + (m.x.z * v.z) + m.x.w;
 		float y = (m.y.x * v.x) + (m.y.y * v.y) + (m.y.z * v.z) + m.y.w;
 		float z = (m.z.x * v.x) + (m.z.y * v.y) + (m.z.z * v.z) + m.z.w;
 		float w = (m.w.x * v.x) + (m.w.y * v.y) + (m.w.z * v.z) + m.w.w;
 		
 		return vec4{x, y, z, w};
+#endif
 	}
 
 	mat4 mult(const mat4& a, const mat4& b) {
+#if defined(CPU_X86) || defined(CPU_NEON)
+		auto b0 = load(b.x), b1 = load(b.y), b2 = load(b.z), b3 = load(b.w);
+
+		mat4 out;
+		store(out.x, mult_row(a.x, b0, b1, b2, b3));
+		store(out.y, mult_row(a.y, b0, b1, b2, b3));
+		store(out.z, mult_row(a.z, b0, b1, b2, b3));
+		store(out.w, mult_row(a.w, b0, b1, b2, b3));
+		return out;
+#else
 		float xx = a.x.x * b.x.x + a.x.y * b.y.x + a.x.z * b.z.x + a.x.w * b.w.x;
 		float xy = a.x.x * b.x.y + a.x.y * b.y.y + a.x.z * b.z.y + a.x.w * b.w.y;
 		float xz = a.x.x * b.x.z + a.x.y * b.y.z + a.x.z * b.z.z + a.x.w * b.w.z;
@@ -49,8 +124,29 @@ namespace maths {
 			{zx, zy, zz, zw},
 			{wx, wy, wz, ww}
 		};
+#endif
+	}
+
+	void mult(const mat4& m, const vec4* in, vec4* out, int count) {
+		for (int i = 0; i < count; i++)
+			out[i] = mult(m, in[i]);
 	}
 
+	void mult(const mat4* a, const mat4& b, mat4* out, int count) {
+#if defined(CPU_X86) || defined(CPU_NEON)
+		// b's rows stay in registers across the whole batch
+		auto b0 = load(b.x), b1 = load(b.y), b2 = load(b.z), b3 = load(b.w);
+		for (int i = 0; i < count; i++) {
+			store(out[i].x, mult_row(a[i].x, b0, b1, b2, b3));
+			store(out[i].y, mult_row(a[i].y, b0, b1, b2, b3));
+			store(out[i].z, mult_row(a[i].z, b0, b1, b2, b3));
+			store(out[i].w, mult_row(a[i].w, b0, b1, b2, b3));
+		}
+#else
+		for (int i = 0; i < count; i++)
+			out[i] = mult(a[i], b);
+#endif
+	}
 
 	// http://totologic.blogspot.co.uk/2014/01/accurate-point-in-triangle-test.html
 	bool point_triangle_intersect(const vec2& p, const vec2& a, const vec2& b, const vec2& c) {
@@ -66,16 +162,22 @@ namespace maths {
 			0.f <= z && z <= 1.f;
 	}
 
-	float lerp(float a, float b, float t) {
-		return (1 - t) * a + t * b;
-	}
-
 	vec3 lerp(vec3 a, vec3 b, float t) {
 		return ((1.f - t) * b) + (t * a);
 	}
 
 	vec4 lerp(vec4 a, vec4 b, float t) {
+#if defined(CPU_X86)
+		vec4 out;
+		store(out, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.f - t), load(b)), _mm_mul_ps(_mm_set1_ps(t), load(a))));
+		return out;
+#elif defined(CPU_NEON)
+		vec4 out;
+		store(out, vmlaq_n_f32(vmulq_n_f32(load(b), 1.f - t), load(a), t));
+		return out;
+#else
 		return ((1.f - t) * b) + (t * a);
+#endif
 	}
 
 	bool almost_equal(float x, float y, float error_factor) {
@@ -99,18 +201,6 @@ namespace maths {
 		};
 	}
 
-	vec3 cross_product(const vec3& a, const vec3& b) {
-		return {
-			a.y * b.z - a.z * b.y,
-			a.z * b.x - a.x * b.z,
-			a.x * b.y - a.y * b.x
-		};
-	}
-
-	float determinant(const vec2& a, const vec2& b) {
-		return (a.x * b.y) - (a.y * b.x);
-	}
-
 	float distance(const vec2& a, const vec2& b) {
 		return sqrt(
 			(a.x - b.x) * (a.x - b.x) +
@@ -135,16 +225,14 @@ namespace maths {
 		);
 	}
 
-	float dot_product(const vec2& a, const vec2& b) { 
-		return (a.x * b.x) + (a.y * b.y); 
-	}
-
-	float dot_product(const vec3& a, const vec3& b) { 
-		return (a.x * b.x) + (a.y * b.y) + (a.z * b.z); 
-	}
-
 	float dot_product(const vec4& a, const vec4& b) { 
+#if defined(CPU_X86)
+		return horizontal_sum(_mm_mul_ps(load(a), load(b)));
+#elif defined(CPU_NEON)
+		return horizontal_sum(vmulq_f32(load(a), load(b)));
+#else
 		return (a.x * b.x) + (a.y * b.y) + (a.z * b.z) + (a.w * b.w); 
+#endif
 	}
 
 	float magnitude(const vec2& v) { 
@@ -168,18 +256,16 @@ namespace maths {
 	}
 
 	vec4 normalise(const vec4& v) { 
-		return (v == vec4{0.f}) ? v : v / magnitude(v); 
-	}
-
-	mat4 orthographic_matrix(const vec2& resolution, float nZ, float fZ, mat4 m) {
-		m.x.x =  2.f / resolution.x;
-		m.y.y =  2.f / resolution.y;
-		m.z.z = -2.f / (fZ - nZ);
-
-		m.w.x = -resolution.x / resolution.x;
-		m.w.y = -resolution.y / resolution.y;
-		m.w.z = -(fZ + nZ) / (fZ - nZ);
-		return m;
+		if (v == vec4{0.f})
+			return v;
+#if defined(CPU_X86)
+		__m128 r = load(v);
+		vec4 out;
+		store(out, _mm_div_ps(r, _mm_sqrt_ps(_mm_set1_ps(horizontal_sum(_mm_mul_ps(r, r))))));
+		return out;
+#else
+		return v / magnitude(v);
+#endif
 	}
 
 	bool check_clockwise(vec2 v1, vec2 v2) {
@@ -210,67 +296,92 @@ namespace maths {
 
 	mat4 rotate_x(float degrees) {
 		float rads = degrees * (PI / 180.f);
+		float c = cosf(rads), s = sinf(rads);
 
 		return mat4{
-			{1.f, 0.f,        0.f,       0.f},
-			{0.f, cos(rads), -sin(rads), 0.f},
-			{0.f, sin(rads),  cos(rads), 0.f},
-			{0.f, 0.f,        0.f,       1.f}
+			{1.f, 0.f, 0.f, 0.f},
+			{0.f, c,   -s,  0.f},
+			{0.f, s,   c,   0.f},
+			{0.f, 0.f, 0.f, 1.f}
 		};
 	}
 
 	mat4 rotate_y(float degrees) {
 		float rads = degrees * (PI / 180.f);
+		float c = cosf(rads), s = sinf(rads);
 
 		return mat4{
-			{cos(rads),  0.f,       sin(rads), 0.f},
-			{0.f,        1.f,       0.f,       0.f},
-			{-sin(rads), 0.f,       cos(rads), 0.f},
-			{0.f,        0.f,       0.f,       1.f}
+			{c,   0.f, s,   0.f},
+			{0.f, 1.f, 0.f, 0.f},
+			{-s,  0.f, c,   0.f},
+			{0.f, 0.f, 0.f, 1.f}
 		};
 	}
 
 	mat4 rotate_z(float degrees) {
 		float rads = degrees * (PI / 180.f);
+		float c = cosf(rads), s = sinf(rads);
 
 		return mat4{
-			{cos(rads), -sin(rads), 0.f, 0.f},
-			{sin(rads),  cos(rads), 0.f, 0.f},
-			{0.f,        0.f,       1.f, 0.f},
-			{0.f,        0.f,       0.f, 1.f}
+			{c,   -s,  0.f, 0.f},
+			{s,   c,   0.f, 0.f},
+			{0.f, 0.f, 1.f, 0.f},
+			{0.f, 0.f, 0.f, 1.f}
 		};
 	}
 
-	mat4 translate(const vec3& position) {
-		mat4 m = {};
-		m.x.w = position.x;
-		m.y.w = position.y;
-		m.z.w = position.z;
-		return m;
-	}
-
-	mat4 scale(const vec3& size) {
-		mat4 m = {};
-		m.x.x = size.x;
-		m.y.y = size.y;
-		m.z.z = size.z;
-		return m;
-	}
+	// Rows of scale * (rotate_z * rotate_y * rotate_x), with the translation in the last row
+	mat4 scale_rotate_translate(const vec3& size, const vec3& rotation, const vec3& position) {
+		float rx = to_radians(rotation.x), ry = to_radians(rotation.y), rz = to_radians(rotation.z);
+		float cx = cosf(rx), sx = sinf(rx);
+		float cy = cosf(ry), sy = sinf(ry);
+		float cz = cosf(rz), sz = sinf(rz);
 
-	float to_degrees(const float rads) {
-		return rads * 180.f / PI;
+		return mat4{
+			{size.x * (cz * cy), size.x * (cz * sy * sx - sz * cx), size.x * (cz * sy * cx + sz * sx), 0.f},
+			{size.y * (sz * cy), size.y * (sz * sy * sx + cz * cx), size.y * (sz * sy * cx - cz * sx), 0.f},
+			{size.z * (-sy),     size.z * (cy * sx),                size.z * (cy * cx),                0.f},
+			{position.x, position.y, position.z, 1.f}
+		};
 	}
 
-	float to_radians(const float degs) {
-		return degs / 180.f * PI;
+	void scale_translate(const vec3* sizes, const vec3* positions, mat4* out, int count) {
+		for (int i = 0; i < count; i++) {
+			mat4& m = out[i];
+			m.x = vec4{sizes[i].x, 0.f, 0.f, 0.f};
+			m.y = vec4{0.f, sizes[i].y, 0.f, 0.f};
+			m.z = vec4{0.f, 0.f, sizes[i].z, 0.f};
+			m.w = vec4{positions[i], 1.f};
+		}
 	}
 
 	mat4 transpose(const mat4& m) {
+#if defined(CPU_X86)
+		__m128 r0 = load(m.x), r1 = load(m.y), r2 = load(m.z), r3 = load(m.w);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		mat4 out;
+		store(out.x, r0);
+		store(out.y, r1);
+		store(out.z, r2);
+		store(out.w, r3);
+		return out;
+#elif defined(CPU_NEON)
+		float32x4x4_t c = vld4q_f32(m.x.n);
+
+		mat4 out;
+		store(out.x, c.val[0]);
+		store(out.y, c.val[1]);
+		store(out.z, c.val[2]);
+		store(out.w, c.val[3]);
+		return out;
+#else
 		return mat4{
 			{m.x.x, m.y.x, m.z.x, m.w.x},
 			{m.x.y, m.y.y, m.z.y, m.w.y},
 			{m.x.z, m.y.z, m.z.z, m.w.z},
 			{m.x.w, m.y.w, m.z.w, m.w.w}
 		};
+#endif
 	}
 }
\ No newline at end of file
@@ -4,13 +4,13 @@
 #include <string>
 																													   
 namespace maths {
-	extern float PI;
+	constexpr float PI = 3.14159265358979f;
 
 	class vec2 {
 	public:
-		vec2() : n{0.f, 0.f} {}
-		vec2(const float v) : n{v, v} {}
-		vec2(const float x, const float y) : n{x, y} {}
+		constexpr vec2() : x(0.f), y(0.f) {}
+		constexpr vec2(const float v) : x(v), y(v) {}
+		constexpr vec2(const float x, const float y) : x(x), y(y) {}
 
 		vec2& operator  = (const vec2& v) { x  = v.x; y  = v.y; return *this; }
 		vec2& operator += (const vec2& v) { x += v.x; y += v.y; return *this; }
@@ -18,17 +18,17 @@ namespace maths {
 		vec2& operator *= (const float v) { x *= v; y *= v; return *this; }
 		vec2& operator /= (const float v) { x /= v; y /= v; return *this; }
 
-		inline       float& operator [] (int i)       { return n[i]; }
-		inline const float& operator [] (int i) const { return n[i]; }
+		inline           float& operator [] (int i)       { return (&x)[i]; }
+		constexpr const float& operator [] (int i) const { return i == 0 ? x : y; }
 
-		friend bool operator == (const vec2& a, const vec2& b) { return a.x == b.x && a.y == b.y; }
-		friend bool operator != (const vec2& a, const vec2& b) { return !(a == b); }
+		friend constexpr bool operator == (const vec2& a, const vec2& b) { return a[0] == b[0] && a[1] == b[1]; }
+		friend constexpr bool operator != (const vec2& a, const vec2& b) { return !(a == b); }
 
-		friend vec2 operator + (const vec2& a, const vec2& b) { return { a.x + b.x, a.y + b.y }; }
-		friend vec2 operator - (const vec2& a, const vec2& b) { return { a.x - b.x, a.y - b.y }; }
-		friend vec2 operator * (const vec2& a, const float v) { return { a.x * v, a.y * v }; }
-		friend vec2 operator / (const vec2& a, const float v) { return { a.x / v, a.y / v }; }
-		friend vec2 operator / (const vec2& a, const vec2& b) { return { a.x / b.x, a.y / b.y}; }
+		friend constexpr vec2 operator + (const vec2& a, const vec2& b) { return { a[0] + b[0], a[1] + b[1] }; }
+		friend constexpr vec2 operator - (const vec2& a, const vec2& b) { return { a[0] - b[0], a[1] - b[1] }; }
+		friend constexpr vec2 operator * (const vec2& a, const float v) { return { a[0] * v, a[1] * v }; }
+		friend constexpr vec2 operator / (const vec2& a, const float v) { return { a[0] / v, a[1] / v }; }
+		friend constexpr vec2 operator / (const vec2& a, const vec2& b) { return { a[0] / b[0], a[1] / b[1]}; }
 
 		friend std::ostream& operator << (std::ostream& os, const vec2& v) { 
 			os << "(" << v.x << ", " << v.y << ")"; 
@@ -39,21 +39,18 @@ namespace maths {
 			return std::to_string(v.x) + ", " + std::to_string(v.y);
 		}
 
-		union {
-			float n[2];
-			struct {
-				float x;
-				float y;
-			};
-		};
+		// Plain members rather than a union with an array, so x and y can be read
+		// in constant expressions such as BarLayout's tables
+		float x;
+		float y;
 	};
 
 	class vec3 {
 	public:
-		vec3() : n{0.f, 0.f, 0.f} {}
-		vec3(const float v) : n{v, v, v} {}
-		vec3(const float x, const float y, const float z) : n{x, y, z} {}
-		vec3(const vec2& v, const float z) : n{v.x, v.y, z} {}
+		constexpr vec3() : n{0.f, 0.f, 0.f} {}
+		constexpr vec3(const float v) : n{v, v, v} {}
+		constexpr vec3(const float x, const float y, const float z) : n{x, y, z} {}
+		constexpr vec3(const vec2& v, const float z) : n{v[0], v[1], z} {}
 		
 		vec2 XY() { return vec2{x, y}; }
 		vec2 XZ() { return vec2{x, z}; }
@@ -65,17 +62,17 @@ namespace maths {
 		vec3& operator *= (const float v) { x *= v; y *= v; z *= v; return *this; }
 		vec3& operator /= (const float v) { x /= v; y /= v; z /= v; return *this; }
 
-		inline       float& operator [] (int i)       { return n[i]; }
-		inline const float& operator [] (int i) const { return n[i]; }
+		inline           float& operator [] (int i)       { return n[i]; }
+		constexpr const float& operator [] (int i) const { return n[i]; }
 
-		friend bool operator == (const vec3& a, const vec3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
-		friend bool operator != (const vec3& a, const vec3& b) { return !(a == b); }
+		friend constexpr bool operator == (const vec3& a, const vec3& b) { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; }
+		friend constexpr bool operator != (const vec3& a, const vec3& b) { return !(a == b); }
 
-		friend vec3 operator + (const vec3& a, const vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
-		friend vec3 operator - (const vec3& a, const vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
-		friend vec3 operator / (const vec3& a, const float b) { return { a.x / b, a.y / b, a.z / b }; }
-		friend vec3 operator * (const vec3& a, const float b) { return { a.x * b, a.y * b, a.z * b }; }
-		friend vec3 operator * (const float a, const vec3& b) { return { b.x * a, b.y * a, b.z * a }; }
+		friend constexpr vec3 operator + (const vec3& a, const vec3& b) { return { a[0] + b[0], a[1] + b[1], a[2] + b[2] }; }
+		friend constexpr vec3 operator - (const vec3& a, const vec3& b) { return { a[0] - b[0], a[1] - b[1], a[2] - b[2] }; }
+		friend constexpr vec3 operator / (const vec3& a, const float b) { return { a[0] / b, a[1] / b, a[2] / b }; }
+		friend constexpr vec3 operator * (const vec3& a, const float b) { return { a[0] * b, a[1] * b, a[2] * b }; }
+		friend constexpr vec3 operator * (const float a, const vec3& b) { return { b[0] * a, b[1] * a, b[2] * a }; }
 
 		friend std::ostream& operator << (std::ostream& os, const vec3& v) { 
 			os << "(" << v.x << ", " << v.y << ", " << v.z << ")"; 
@@ -92,12 +89,13 @@ namespace maths {
 		};
 	};
 	
-	class vec4 {
+	// 16-byte aligned so rows load straight into SIMD registers
+	class alignas(16) vec4 {
 	public:
-		vec4() : n{0.f, 0.f, 0.f, 0.f} {}
-		vec4(const float v) : n{v, v, v, v} {}
-		vec4(const float x, const float y, const float z, const float w) : n{x, y, z, w} {}
-		vec4(const vec3& v, const float w) : n{ v.x, v.y, v.z, w } {}
+		constexpr vec4() : n{0.f, 0.f, 0.f, 0.f} {}
+		constexpr vec4(const float v) : n{v, v, v, v} {}
+		constexpr vec4(const float x, const float y, const float z, const float w) : n{x, y, z, w} {}
+		constexpr vec4(const vec3& v, const float w) : n{ v[0], v[1], v[2], w } {}
 
 		vec2 XY() { return vec2{x, y}; }
 		vec3 XYZ() { return vec3(x, y, z); }
@@ -108,17 +106,17 @@ namespace maths {
 		vec4& operator *= (const float v) { x *= v; y *= v; z *= v; w *= v; return *this; }
 		vec4& operator /= (const float v) { x /= v; y /= v; z /= v; w /= v; return *this; }
 
-		inline       float& operator [] (int i) { return n[i]; }
-		inline const float& operator [] (int i) const { return n[i]; }
+		inline           float& operator [] (int i) { return n[i]; }
+		constexpr const float& operator [] (int i) const { return n[i]; }
 
-		friend bool operator == (const vec4& a, const vec4& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; }
-		friend bool operator != (const vec4& a, const vec4& b) { return !(a == b); }
+		friend constexpr bool operator == (const vec4& a, const vec4& b) { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3]; }
+		friend constexpr bool operator != (const vec4& a, const vec4& b) { return !(a == b); }
 
-		friend vec4 operator + (const vec4& a, const vec4& b) { return{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
-		friend vec4 operator - (const vec4& a, const vec4& b) { return{a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
-		friend vec4 operator * (const vec4& a, const float v) { return{a.x * v, a.y * v, a.z * v, a.w * v}; }
-		friend vec4 operator * (const float v, const vec4& a) { return{a.x * v, a.y * v, a.z * v, a.w * v }; }
-		friend vec4 operator / (const vec4& a, const float v) { return{a.x / v, a.y / v, a.z / v, a.w / v}; }
+		friend constexpr vec4 operator + (const vec4& a, const vec4& b) { return{a[0] + b[0], a[1] + b[1], a[2] + b[2], a[3] + b[3]}; }
+		friend constexpr vec4 operator - (const vec4& a, const vec4& b) { return{a[0] - b[0], a[1] - b[1], a[2] - b[2], a[3] - b[3]}; }
+		friend constexpr vec4 operator * (const vec4& a, const float v) { return{a[0] * v, a[1] * v, a[2] * v, a[3] * v}; }
+		friend constexpr vec4 operator * (const float v, const vec4& a) { return{a[0] * v, a[1] * v, a[2] * v, a[3] * v }; }
+		friend constexpr vec4 operator / (const vec4& a, const float v) { return{a[0] / v, a[1] / v, a[2] / v, a[3] / v}; }
 
 
 		friend std::ostream& operator << (std::ostream& os, const vec4& v) { 
@@ -137,15 +135,15 @@ namespace maths {
 		};
 	};
 
-	class mat4 {
+	class alignas(16) mat4 {
 	public:
-		mat4() : n{{1, 0, 0, 0},{0, 1, 0, 0},{0, 0, 1, 0},{0, 0, 0, 1}} {}
-		mat4(const vec4& a, const vec4& b, const vec4& c, const vec4& d) : n{a, b, c, d} {}
+		constexpr mat4() : x{1, 0, 0, 0}, y{0, 1, 0, 0}, z{0, 0, 1, 0}, w{0, 0, 0, 1} {}
+		constexpr mat4(const vec4& a, const vec4& b, const vec4& c, const vec4& d) : x(a), y(b), z(c), w(d) {}
 
 		mat4& operator = (const mat4& v) { x = v.x; y = v.y; z = v.z; w = v.w; return *this; }
 
-		inline       vec4& operator [] (int i)       { return n[i]; }
-		inline const vec4& operator [] (int i) const { return n[i]; }
+		inline           vec4& operator [] (int i)       { return (&x)[i]; }
+		constexpr const vec4& operator [] (int i) const { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
 
 		friend std::ostream& operator << (std::ostream& os, const mat4& v) { 
 			os << v.x << std::endl << v.y << std::endl << v.z << std::endl << v.w << std::endl;
@@ -155,15 +153,12 @@ namespace maths {
 		void scale(const vec3& v) { x.x = v.x; y.y = v.y; z.z = v.z; }
 		void translate(const vec3& v) { w.x = v.x; w.y = v.y; w.z = v.z; }
 
-		union {
-			vec4 n[4];
-			struct {
-				vec4 x;
-				vec4 y;
-				vec4 z;
-				vec4 w;
-			};
-		};
+		// Plain rows rather than a union with an array: anonymous structs of
+		// non-trivial types are an MSVC extension
+		vec4 x;
+		vec4 y;
+		vec4 z;
+		vec4 w;
 	};
 
 	bool almost_equal(float x, float y, float error_factor);
@@ -174,19 +169,36 @@ namespace maths {
 	float cartesian_to_polar(const vec2& v);
 
 	vec2 cross_product(const vec2& a, const vec2& b);
-	vec3 cross_product(const vec3& a, const vec3& b);
+	constexpr vec3 cross_product(const vec3& a, const vec3& b) {
+		return {
+			a[1] * b[2] - a[2] * b[1],
+			a[2] * b[0] - a[0] * b[2],
+			a[0] * b[1] - a[1] * b[0]
+		};
+	}
 
-	float determinant(const vec2& a, const vec2& b);
+	constexpr float determinant(const vec2& a, const vec2& b) {
+		return (a[0] * b[1]) - (a[1] * b[0]);
+	}
 
 	float distance(const vec2& a, const vec2& b);
 	float distance(const vec3& a, const vec3& b);
 	float distance(const vec4& a, const vec4& b);
 
-	float dot_product(const vec2& a, const vec2& b);
-	float dot_product(const vec3& a, const vec3& b);
+	constexpr float dot_product(const vec2& a, const vec2& b) {
+		return (a[0] * b[0]) + (a[1] * b[1]);
+	}
+
+	constexpr float dot_product(const vec3& a, const vec3& b) {
+		return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+	}
+
 	float dot_product(const vec4& a, const vec4& b);
 
-	float lerp(float a, float b, float t);
+	constexpr float lerp(float a, float b, float t) {
+		return (1 - t) * a + t * b;
+	}
+
 	vec3 lerp(vec3 a, vec3 b, float t);
 	vec4 lerp(vec4 a, vec4 b, float t);
 
@@ -201,11 +213,23 @@ namespace maths {
 	vec4 mult(const mat4& m, const vec4& v);
 	mat4 mult(const mat4& a, const mat4& b);
 
+	// Batch forms: out[i] = mult(m, in[i]) and out[i] = mult(a[i], b)
+	void mult(const mat4& m, const vec4* in, vec4* out, int count);
+	void mult(const mat4* a, const mat4& b, mat4* out, int count);
+
 	vec2 normalise(const vec2& v);
 	vec3 normalise(const vec3& v);
 	vec4 normalise(const vec4& v);
 	
-	mat4 orthographic_matrix(const vec2& resolution, float nZ, float fZ, mat4 m);
+	// Replaces the scale and translation terms of m
+	constexpr mat4 orthographic_matrix(const vec2& resolution, float nZ, float fZ, const mat4& m) {
+		return mat4{
+			{2.f / resolution[0], m[0][1], m[0][2], m[0][3]},
+			{m[1][0], 2.f / resolution[1], m[1][2], m[1][3]},
+			{m[2][0], m[2][1], -2.f / (fZ - nZ), m[2][3]},
+			{-resolution[0] / resolution[0], -resolution[1] / resolution[1], -(fZ + nZ) / (fZ - nZ), m[3][3]}
+		};
+	}
 
 	bool point_triangle_intersect(const vec2& p, const vec2& a, const vec2& b, const vec2& c);
 	bool point_segment_intersect(const vec2& p, const vec2& start, const vec2& o, const vec2& end, const float radius);
@@ -218,13 +242,45 @@ namespace maths {
 	mat4 rotate_z(float degrees);
 	mat4 rotate(const vec3& rotation);
 
-	mat4 scale(const vec3& size);
+	constexpr mat4 scale(const vec3& size) {
+		return mat4{
+			{size[0], 0.f,     0.f,     0.f},
+			{0.f,     size[1], 0.f,     0.f},
+			{0.f,     0.f,     size[2], 0.f},
+			{0.f,     0.f,     0.f,     1.f}
+		};
+	}
+
+	// Fused builders, equal to mult(scale(size), transpose(translate(position))) and
+	// mult(mult(scale(size), rotate(rotation)), transpose(translate(position)))
+	constexpr mat4 scale_translate(const vec3& size, const vec3& position) {
+		return mat4{
+			{size[0],     0.f,         0.f,         0.f},
+			{0.f,         size[1],     0.f,         0.f},
+			{0.f,         0.f,         size[2],     0.f},
+			{position[0], position[1], position[2], 1.f}
+		};
+	}
 
-	float to_degrees(const float rads);
-	
-	float to_radians(const float degs);
+	mat4 scale_rotate_translate(const vec3& size, const vec3& rotation, const vec3& position);
+	void scale_translate(const vec3* sizes, const vec3* positions, mat4* out, int count);
 
-	mat4 translate(const vec3& position);
+	constexpr float to_degrees(const float rads) {
+		return rads * 180.f / PI;
+	}
+	
+	constexpr float to_radians(const float degs) {
+		return degs / 180.f * PI;
+	}
+
+	constexpr mat4 translate(const vec3& position) {
+		return mat4{
+			{1.f, 0.f, 0.f, position[0]},
+			{0.f, 1.f, 0.f, position[1]},
+			{0.f, 0.f, 1.f, position[2]},
+			{0.f, 0.f, 0.f, 1.f}
+		};
+	}
 
 	mat4 transpose(const mat4& m);
 }
\ No newline at end of file
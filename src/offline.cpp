@@ -0,0 +1,194 @@
+#include "offline.h"
+
+#include <bass.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "bar_dynamics.h"
+#include "bass_decoder.h"
+#include "spectrum.h"
+#include "stft.h"
+
+// Fill bar i, centred horizontally, with the colour t of the way from quiet to loud
+static void fill_bar(int i, float length, int num_bins, int width, int height, const unsigned char* quiet, const unsigned char* loud, unsigned char* rgba) {
+	const float loudness_scale = 400.f;
+	const float bin_height = (float)height / (float)num_bins;
+	const float centre_x = (float)width * 0.5f;
+
+	float t = std::min(std::max(length / loudness_scale, 0.f), 1.f);
+	unsigned char colour[3];
+	for (int c = 0; c < 3; c++)
+		colour[c] = (unsigned char)(quiet[c] + (loud[c] - quiet[c]) * t + 0.5f);
+
+	// Pixel centres inside the bar, matching GL's rasterisation rule
+	float half_length = length * 0.5f;
+	int x0 = std::max(0, (int)ceilf(centre_x - half_length - 0.5f));
+	int x1 = std::min(width, (int)ceilf(centre_x + half_length - 0.5f));
+	int y0 = std::max(0, (int)ceilf(i * bin_height - 0.5f));
+	int y1 = std::min(height, (int)ceilf((i + 1) * bin_height - 0.5f));
+
+	for (int y = y0; y < y1; y++) {
+		unsigned char* row = rgba + ((height - 1 - y) * width) * 4;
+		for (int x = x0; x < x1; x++) {
+			row[x * 4 + 0] = colour[0];
+			row[x * 4 + 1] = colour[1];
+			row[x * 4 + 2] = colour[2];
+		}
+	}
+}
+
+// CPU equivalent of the bar and peak BarRenderers: grey peaks behind horizontal
+// bars centred on the screen, quiet bins green through to red at loudness_scale.
+// Rows are written top-down.
+static void rasterise_bars(const float* bins, const float* peaks, int num_bins, int width, int height, unsigned char* rgba) {
+	static const unsigned char green[3] = { 0, 255, 0 };
+	static const unsigned char red[3] = { 255, 0, 0 };
+	static const unsigned char dark_grey[3] = { 64, 64, 64 };
+	static const unsigned char grey[3] = { 128, 128, 128 };
+
+	std::fill(rgba, rgba + width * height * 4, (unsigned char)0);
+	for (int i = 3; i < width * height * 4; i += 4)
+		rgba[i] = 255;
+
+	for (int i = 0; i < num_bins; i++) {
+		fill_bar(i, peaks[i], num_bins, width, height, dark_grey, grey, rgba);
+		fill_bar(i, bins[i], num_bins, width, height, green, red, rgba);
+	}
+}
+
+static bool write_ppm(const char* filename, const unsigned char* rgba, int width, int height, std::vector<unsigned char>& rgb) {
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	for (int i = 0; i < width * height; i++) {
+		rgb[i * 3 + 0] = rgba[i * 4 + 0];
+		rgb[i * 3 + 1] = rgba[i * 4 + 1];
+		rgb[i * 3 + 2] = rgba[i * 4 + 2];
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+	fclose(file);
+	return ok;
+}
+
+int render_offline(const OfflineSettings& settings) {
+	// Device 0 is BASS's "no sound" device, decoding needs no output
+	if (!BASS_Init(0, 44100, 0, 0, 0)) {
+		fprintf(stderr, "*** Offline Error: Bass failed to initialise\n");
+		return EXIT_FAILURE;
+	}
+
+	dsp::register_decoder(&dsp::BassDecoder::open);
+
+	std::unique_ptr<dsp::Decoder> decoder = dsp::open_decoder(settings.track);
+	if (!decoder) {
+		fprintf(stderr, "*** Offline Error: Failed to open %s\n", settings.track);
+		BASS_Free();
+		return EXIT_FAILURE;
+	}
+
+	const int channels = std::max(1, decoder->channels);
+	const double sample_rate = (double)decoder->sample_rate;
+
+	bool to_stdout = strcmp(settings.output, "-") == 0;
+#ifdef _WIN32
+	if (to_stdout)
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	dsp::STFT stft{ settings.fft_size, settings.hop_size, (float)sample_rate, settings.window, settings.kaiser_beta };
+	const int fft_samples = stft.num_bins;
+
+	// Decoded a hop at a time so the STFT queue never holds more than one frame
+	std::vector<float> interleaved((size_t)settings.hop_size * channels);
+	std::vector<float> mono(settings.hop_size);
+
+	std::vector<float> spectrum(fft_samples);
+	dsp::BandMap band_map{ settings.band_scale, fft_samples, settings.num_bins, (float)sample_rate };
+	dsp::BinKernel bin_kernel{ band_map, settings.fft_scale };
+	std::vector<float> levels(settings.num_bins, 0.f);
+
+	// Same fixed-step dynamics as the live view, so frames match whatever the fps
+	dsp::BarDynamics dynamics{ settings.num_bins, settings.fft_scale };
+	std::vector<float> bins(settings.num_bins, 0.f);
+	std::vector<float> peaks(settings.num_bins, 0.f);
+
+	std::vector<unsigned char> rgba((size_t)settings.width * settings.height * 4);
+	std::vector<unsigned char> rgb((size_t)settings.width * settings.height * 3);
+	char filename[1024];
+
+	long long decoded = 0;
+	bool ended = false;
+	int frame = 0;
+	int result = EXIT_SUCCESS;
+
+	while (!ended) {
+		// Decode up to the audio position of this video frame
+		long long target = (long long)((frame + 1) * sample_rate / settings.fps);
+		while (decoded < target) {
+			int wanted = (int)std::min<long long>(target - decoded, (long long)mono.size());
+			int frames = decoder->read(interleaved.data(), wanted);
+			if (frames == 0) {
+				ended = true;
+				break;
+			}
+
+			dsp::mix_to_mono(interleaved.data(), frames, channels, mono.data());
+			stft.push(mono.data(), frames);
+			decoded += frames;
+
+			// Run the steps the new audio covers, consuming STFT frames as they go
+			const double decoded_time = (double)decoded / sample_rate;
+			while (dynamics.due(decoded_time)) {
+				stft.sample(dynamics.step_time(), spectrum.data());
+				bin_kernel.levels(spectrum.data(), levels.data());
+				dynamics.step(levels.data());
+			}
+		}
+
+		if (ended && decoded < target)
+			break;
+
+		dynamics.interpolate((double)decoded / sample_rate, bins.data(), peaks.data());
+		rasterise_bars(bins.data(), peaks.data(), settings.num_bins, settings.width, settings.height, rgba.data());
+
+		bool ok;
+		if (to_stdout) {
+			ok = fwrite(rgba.data(), 1, rgba.size(), stdout) == rgba.size();
+		}
+		else {
+			snprintf(filename, sizeof(filename), "%s/frame_%06d.ppm", settings.output, frame);
+			ok = write_ppm(filename, rgba.data(), settings.width, settings.height, rgb);
+		}
+
+		if (!ok) {
+			fprintf(stderr, "*** Offline Error: Failed to write frame %d\n", frame);
+			result = EXIT_FAILURE;
+			break;
+		}
+
+		frame++;
+	}
+
+	if (to_stdout)
+		fflush(stdout);
+	else
+		fprintf(stderr, "Rendered %d frames to %s\n", frame, settings.output);
+
+	decoder.reset();
+	BASS_Free();
+
+	return result;
+}
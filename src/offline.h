@@ -0,0 +1,24 @@
+#pragma once
+
+#include "band_map.h"
+#include "fft.h"
+
+// Settings for rendering a whole track without a window or audio device
+struct OfflineSettings {
+	const char* track;
+	const char* output;		// Directory for numbered PPM files, or "-" for raw RGBA on stdout
+	int fps;
+	int width;
+	int height;
+	int fft_size;
+	int hop_size;
+	dsp::Window window;
+	float kaiser_beta;
+	int num_bins;
+	dsp::BandScale band_scale;
+	float fft_scale;
+};
+
+// Decode the track as fast as possible through the STFT and rasterise one frame
+// of bars per 1 / fps seconds of audio on the CPU. Returns a process exit code.
+int render_offline(const OfflineSettings& settings);
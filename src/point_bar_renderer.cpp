@@ -0,0 +1,65 @@
+#include "point_bar_renderer.h"
+
+#include <cstddef>
+
+PointBarRenderer::PointBarRenderer(int num_bins, const maths::vec2& resolution) :
+	PointBarRenderer(num_bins, resolution.y / (float)num_bins, resolution.x * 0.5f)
+{
+}
+
+PointBarRenderer::PointBarRenderer(int num_bins, float bin_height, float bin_pos_x) :
+	BarBackend(num_bins, bin_height, bin_pos_x),
+	shader("shaders/v.point_bars.glsl", "shaders/f.vertex_colour.glsl", "shaders/g.point_bars.glsl"),
+	points(GL_ARRAY_BUFFER, num_bins * sizeof(BarPoint))
+{
+	u_projection = shader.uniform("projection");
+	u_bin_height = shader.uniform("bin_height");
+	u_bin_pos_x = shader.uniform("bin_pos_x");
+	u_colour_quiet = shader.uniform("colour_quiet");
+	u_colour_loud = shader.uniform("colour_loud");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// One point per bar, each frame's segment is selected with the first vertex
+	glBindBuffer(GL_ARRAY_BUFFER, points.buffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(BarPoint), (void*)offsetof(BarPoint, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(BarPoint), (void*)offsetof(BarPoint, length));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(BarPoint), (void*)offsetof(BarPoint, loudness));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void PointBarRenderer::update(const float* bins) {
+	BarPoint* dst = (BarPoint*)points.map_next();
+	const float inv_loudness = 1.f / loudness_scale;
+	for (int i = 0; i < num_bins; i++)
+		dst[i] = BarPoint{ (bin_height * 0.5f) + (i * bin_height), bins[i], bins[i] * inv_loudness };
+}
+
+void PointBarRenderer::draw(const maths::mat4& projection) {
+	shader.use();
+	shader.set_uniform(u_projection, projection);
+	shader.set_uniform(u_bin_height, bin_height);
+	shader.set_uniform(u_bin_pos_x, bin_pos_x);
+	shader.set_uniform(u_colour_quiet, colour_quiet);
+	shader.set_uniform(u_colour_loud, colour_loud);
+
+	glBindVertexArray(vao);
+	glDrawArrays(GL_POINTS, points.segment * num_bins, num_bins);
+	draw_calls++;
+	glBindVertexArray(0);
+	points.fence();
+
+	shader.release();
+}
+
+void PointBarRenderer::destroy() {
+	points.destroy();
+	glDeleteVertexArrays(1, &vao);
+	shader.destroy();
+}
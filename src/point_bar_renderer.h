@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include "bar_backend.h"
+#include "maths.h"
+#include "shader.h"
+#include "stream_buffer.h"
+
+// Draws every frequency bar from a single point, expanded to its quad by
+// shaders/g.point_bars.glsl. Each frame streams one packed BarPoint per bin
+// and nothing else; no quad mesh or per-instance divisor is involved.
+class PointBarRenderer : public BarBackend {
+public:
+	// Bar centre along the stack, bar length and colour ramp position (0 quiet, 1 loud)
+	struct BarPoint {
+		float position;
+		float length;
+		float loudness;
+	};
+
+	PointBarRenderer(int num_bins, const maths::vec2& resolution);
+
+	// Precomputed placement, e.g. from a compile-time BarLayout
+	PointBarRenderer(int num_bins, float bin_height, float bin_pos_x);
+
+	void update(const float* bins) override;
+	void draw(const maths::mat4& projection) override;
+	void destroy() override;
+
+	unsigned int upload_stalls() const override { return points.stalls; }
+
+private:
+	utils::Shader shader;
+	utils::Uniform u_projection;
+	utils::Uniform u_bin_height;
+	utils::Uniform u_bin_pos_x;
+	utils::Uniform u_colour_quiet;
+	utils::Uniform u_colour_loud;
+
+	GLuint vao;
+	utils::StreamBuffer points;
+};
+
+static_assert(sizeof(PointBarRenderer::BarPoint) == 12, "Bar points are streamed as tightly packed vertices");
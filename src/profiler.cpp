@@ -0,0 +1,169 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace utils {
+	const int Profiler::window_size;
+	const int Profiler::max_events;
+	const int Profiler::query_latency;
+
+	Profiler::Profiler(bool gpu_timing) :
+		gpu_timing(gpu_timing),
+		events(max_events),
+		next_event(0),
+		events_wrapped(false),
+		epoch(clock::now()),
+		frame(0),
+		open_gpu_stage(-1),
+		scratch(window_size)
+	{
+	}
+
+	int Profiler::stage(const char* name) {
+		Stage s{};
+		s.name = name;
+		if (gpu_timing)
+			glGenQueries(query_latency, s.queries);
+
+		stages.push_back(s);
+		return (int)stages.size() - 1;
+	}
+
+	double Profiler::micros(clock::time_point t) const {
+		return std::chrono::duration<double, std::micro>(t - epoch).count();
+	}
+
+	void Profiler::record(int id, bool gpu, double start_us, double duration_us) {
+		Stage& s = stages[id];
+		float ms = (float)(duration_us / 1000.0);
+		if (gpu)
+			s.gpu_ms[s.gpu_count++ % window_size] = ms;
+		else
+			s.cpu_ms[s.cpu_count++ % window_size] = ms;
+
+		events[next_event] = { id, gpu, start_us, duration_us };
+		if (++next_event == max_events) {
+			next_event = 0;
+			events_wrapped = true;
+		}
+	}
+
+	void Profiler::begin(int id) {
+		stages[id].start = clock::now();
+	}
+
+	void Profiler::end(int id) {
+		clock::time_point now = clock::now();
+		double start = micros(stages[id].start);
+		record(id, false, start, micros(now) - start);
+	}
+
+	void Profiler::begin_gpu(int id) {
+		if (!gpu_timing)
+			return;
+
+		assert(open_gpu_stage == -1);
+		open_gpu_stage = id;
+
+		Stage& s = stages[id];
+		int slot = frame % query_latency;
+		s.query_start_us[slot] = micros(clock::now());
+		s.query_pending[slot] = true;
+		glBeginQuery(GL_TIME_ELAPSED, s.queries[slot]);
+	}
+
+	void Profiler::end_gpu(int id) {
+		if (!gpu_timing)
+			return;
+
+		assert(open_gpu_stage == id);
+		(void)id;
+		open_gpu_stage = -1;
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	void Profiler::end_frame() {
+		frame++;
+		if (!gpu_timing)
+			return;
+
+		// The slot about to be reused was issued query_latency - 1 frames ago
+		int slot = frame % query_latency;
+		for (int id = 0; id < (int)stages.size(); id++) {
+			Stage& s = stages[id];
+			if (!s.query_pending[slot])
+				continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(s.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 ns = 0;
+				glGetQueryObjectui64v(s.queries[slot], GL_QUERY_RESULT, &ns);
+				record(id, true, s.query_start_us[slot], ns / 1000.0);
+			}
+			s.query_pending[slot] = false;
+		}
+	}
+
+	float Profiler::percentile(int id, float p, bool gpu) const {
+		const Stage& s = stages[id];
+		int n = std::min(gpu ? s.gpu_count : s.cpu_count, window_size);
+		if (n == 0)
+			return 0.f;
+
+		const float* samples = gpu ? s.gpu_ms : s.cpu_ms;
+		std::copy(samples, samples + n, scratch.begin());
+		int k = std::min(n - 1, (int)(p * (n - 1) + 0.5f));
+		std::nth_element(scratch.begin(), scratch.begin() + k, scratch.begin() + n);
+		return scratch[k];
+	}
+
+	void Profiler::summary(char* out, size_t size) const {
+		size_t used = 0;
+		out[0] = '\0';
+		for (int id = 0; id < (int)stages.size() && used < size; id++) {
+			int written = snprintf(out + used, size - used, "%s%s %.2f/%.2f",
+				id ? " | " : "", stages[id].name, percentile(id, 0.5f), percentile(id, 0.99f));
+			if (written < 0)
+				break;
+			used += written;
+
+			if (stages[id].gpu_count > 0 && used < size) {
+				written = snprintf(out + used, size - used, " (gpu %.2f/%.2f)", percentile(id, 0.5f, true), percentile(id, 0.99f, true));
+				if (written < 0)
+					break;
+				used += written;
+			}
+		}
+	}
+
+	bool Profiler::export_trace(const char* filename) const {
+		FILE* file = fopen(filename, "w");
+		if (!file)
+			return false;
+
+		fprintf(file, "{\"traceEvents\":[\n");
+		int count = events_wrapped ? max_events : next_event;
+		int first = events_wrapped ? next_event : 0;
+		for (int i = 0; i < count; i++) {
+			const Event& e = events[(first + i) % max_events];
+			fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}\n",
+				i ? "," : "", stages[e.stage].name, e.gpu ? "gpu" : "cpu", e.gpu ? 2 : 1, e.start_us, e.duration_us);
+		}
+		fprintf(file, "],\n\"displayTimeUnit\":\"ms\"}\n");
+
+		bool ok = !ferror(file);
+		fclose(file);
+		return ok;
+	}
+
+	void Profiler::destroy() {
+		if (!gpu_timing)
+			return;
+
+		for (Stage& s : stages)
+			glDeleteQueries(query_latency, s.queries);
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <chrono>
+#include <vector>
+
+namespace utils {
+	// Per-stage frame timing. CPU stages are timed with steady_clock, GPU stages
+	// with GL_TIME_ELAPSED queries read back a few frames later so nothing
+	// stalls. Keeps a rolling window per stage for percentiles and a bounded
+	// event log that exports as Chrome trace JSON (chrome://tracing, Perfetto).
+	class Profiler {
+	public:
+		static const int window_size = 240;
+		static const int max_events = 1 << 16;
+
+		explicit Profiler(bool gpu_timing);
+
+		// Register a stage once up front; the returned id is used in the frame loop
+		int stage(const char* name);
+
+		void begin(int id);
+		void end(int id);
+
+		// GL_TIME_ELAPSED queries cannot nest, so only one GPU stage may be open at a
+		// time; end_gpu must be given the stage begin_gpu opened
+		void begin_gpu(int id);
+		void end_gpu(int id);
+
+		// Collect finished GPU queries and advance to the next frame
+		void end_frame();
+
+		// Rolling percentile of a stage in milliseconds, p in [0, 1]
+		float percentile(int id, float p, bool gpu = false) const;
+
+		// Write "name p50/p99" for every stage into out
+		void summary(char* out, size_t size) const;
+
+		bool export_trace(const char* filename) const;
+
+		void destroy();
+
+		bool gpu_timing;
+
+	private:
+		static const int query_latency = 4;
+
+		typedef std::chrono::steady_clock clock;
+
+		struct Stage {
+			const char* name;
+			clock::time_point start;
+			float cpu_ms[window_size];
+			float gpu_ms[window_size];
+			int cpu_count;
+			int gpu_count;
+			GLuint queries[query_latency];
+			double query_start_us[query_latency];
+			bool query_pending[query_latency];
+		};
+
+		struct Event {
+			int stage;
+			bool gpu;
+			double start_us;
+			double duration_us;
+		};
+
+		void record(int id, bool gpu, double start_us, double duration_us);
+		double micros(clock::time_point t) const;
+
+		std::vector<Stage> stages;
+		std::vector<Event> events;
+		int next_event;
+		bool events_wrapped;
+
+		clock::time_point epoch;
+		unsigned int frame;
+		int open_gpu_stage;		// -1 when no query is open
+		mutable std::vector<float> scratch;
+	};
+
+	// Times a CPU stage for the lifetime of the scope
+	class ScopedTimer {
+	public:
+		ScopedTimer(Profiler& profiler, int id) : profiler(profiler), id(id) { profiler.begin(id); }
+		~ScopedTimer() { profiler.end(id); }
+
+	private:
+		Profiler& profiler;
+		int id;
+	};
+}
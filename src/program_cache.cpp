@@ -0,0 +1,121 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "atomic_file.h"
+#include "hash.h"
+#include "mapped_file.h"
+
+namespace utils {
+	const char* program_cache_directory = "shader_cache";
+
+	static const char binary_magic[4] = { 'A', 'V', 'P', 'B' };
+	static const uint32_t binary_version = 1;
+
+	// Followed by length bytes of driver binary
+	struct ProgramBinaryHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint64_t driver_hash;
+		uint32_t format;
+		uint32_t length;
+	};
+
+	static uint64_t driver_hash() {
+		const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+		uint64_t hash = fnv1a_seed;
+		for (GLenum name : names) {
+			const char* str = (const char*)glGetString(name);
+			if (str)
+				hash = fnv1a(hash, str, strlen(str) + 1);
+		}
+		return hash;
+	}
+
+	static std::string entry_path(uint64_t key) {
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+		return program_cache_directory + std::string(name);
+	}
+
+	static bool supports_binaries() {
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	uint64_t program_binary_key(const GLenum* types, const std::string* sources, int count) {
+		uint64_t hash = driver_hash();
+		for (int i = 0; i < count; i++) {
+			uint64_t length = sources[i].size();
+			hash = fnv1a(hash, &types[i], sizeof(types[i]));
+			hash = fnv1a(hash, &length, sizeof(length));
+			hash = fnv1a(hash, sources[i].data(), sources[i].size());
+		}
+		return hash;
+	}
+
+	bool load_program_binary(GLuint program, uint64_t key) {
+		if (!supports_binaries())
+			return false;
+
+		MappedFile file{ entry_path(key).c_str() };
+		if (!file.is_open() || file.size < sizeof(ProgramBinaryHeader))
+			return false;
+
+		const ProgramBinaryHeader* header = (const ProgramBinaryHeader*)file.data;
+		if (memcmp(header->magic, binary_magic, sizeof(binary_magic)) != 0 || header->version != binary_version ||
+			header->key != key || header->driver_hash != driver_hash() || header->length != file.size - sizeof(ProgramBinaryHeader))
+			return false;
+
+		glProgramBinary(program, header->format, file.data + sizeof(ProgramBinaryHeader), (GLsizei)header->length);
+
+		GLint status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		return status == GL_TRUE;
+	}
+
+	void save_program_binary(GLuint program, uint64_t key) {
+		if (!supports_binaries())
+			return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+
+		std::vector<unsigned char> binary(length);
+		ProgramBinaryHeader header = {};
+		glGetProgramBinary(program, length, &length, &header.format, binary.data());
+
+		memcpy(header.magic, binary_magic, sizeof(binary_magic));
+		header.version = binary_version;
+		header.key = key;
+		header.driver_hash = driver_hash();
+		header.length = (uint32_t)length;
+
+#ifdef _WIN32
+		_mkdir(program_cache_directory);
+#else
+		mkdir(program_cache_directory, 0755);
+#endif
+
+		AtomicFile out(entry_path(key).c_str());
+		if (!out.is_open())
+			return;
+
+		bool ok = fwrite(&header, sizeof(header), 1, out.file) == 1 &&
+			fwrite(binary.data(), 1, (size_t)length, out.file) == (size_t)length;
+		out.commit(ok);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+	// On-disk cache of linked program binaries, so warm starts skip GLSL
+	// compilation. A binary is only valid for the driver that produced it, so
+	// entries are keyed by the stage sources plus the GL vendor, renderer and
+	// version strings; anything stale or rejected by the driver simply misses.
+
+	// Directory entries are written to, created on the first save
+	extern const char* program_cache_directory;
+
+	// Key for count stages of the given types and sources on the current context's driver
+	uint64_t program_binary_key(const GLenum* types, const std::string* sources, int count);
+
+	// Load the binary cached under key into program and check it links. False if
+	// there is none or the driver refuses it, the caller then compiles from source.
+	bool load_program_binary(GLuint program, uint64_t key);
+
+	// Store a linked program's binary under key; does nothing if the driver has no binary formats
+	void save_program_binary(GLuint program, uint64_t key);
+}
@@ -1,121 +1,275 @@
 #include "shader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include "file_watcher.h"
+#include "hash.h"
+#include "program_cache.h"
+
 namespace utils {
+	unsigned int Shader::string_lookups = 0;
+	bool Shader::hot_reload = false;
+
+	// Hot reload state. The watcher thread reads changed sources into sources;
+	// the render thread links them into pending without waiting, and only
+	// replaces program once pending has linked.
+	struct Shader::Reloader {
+		std::mutex mutex;
+		std::vector<std::string> sources;
+		std::atomic<bool> changed{ false };
+
+		// Of the newest sources read, so saves that change nothing are skipped
+		uint64_t source_hash = 0;
+
+		GLuint pending = 0;
+		std::vector<GLuint> pending_shaders;
+		std::vector<std::string> pending_sources;
+
+		// Last, so its thread stops before the state it writes goes away
+		std::unique_ptr<FileWatcher> watcher;
+	};
+
+	static uint64_t hash_sources(const std::vector<std::string>& sources) {
+		uint64_t hash = fnv1a_seed;
+		for (const std::string& source : sources) {
+			uint64_t length = source.size();
+			hash = fnv1a(hash, &length, sizeof(length));
+			hash = fnv1a(hash, source.data(), source.size());
+		}
+		return hash;
+	}
+
 	Shader::Shader() {
-		v_shader_filename = "";
-		f_shader_filename = "";
 		program = 0;
 	}
 
-	Shader::Shader(const char* compute_shader_filename) {
-		GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
-		std::string src = load_source(compute_shader_filename);
-		compile(computeShader, src.c_str());
-		
-		program = glCreateProgram();
+	Shader::~Shader() = default;
 
-		glAttachShader(program, computeShader);
+	Shader::Shader(const char* compute_shader_filename) :
+		stages{ { GL_COMPUTE_SHADER, compute_shader_filename } }
+	{
+		build();
+		use();
+	}
 
-		link();
+	Shader::Shader(const char* vertex_shader_filename, const char* fragment_shader_filename) :
+		stages{ { GL_VERTEX_SHADER, vertex_shader_filename }, { GL_FRAGMENT_SHADER, fragment_shader_filename } }
+	{
+		build();
 		use();
 	}
 
-	Shader::Shader(const char* vertex_shader_filename, const char* fragment_shader_filename) {
-		v_shader_filename = vertex_shader_filename;
-		f_shader_filename = fragment_shader_filename;
+	Shader::Shader(const char* vertex_shader_filename, const char* fragment_shader_filename, const char* geom_shader_filename) :
+		stages{ { GL_VERTEX_SHADER, vertex_shader_filename }, { GL_FRAGMENT_SHADER, fragment_shader_filename }, { GL_GEOMETRY_SHADER, geom_shader_filename } }
+	{
+		build();
+		use();
+	}
 
-		GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-		std::string v_src = load_source(vertex_shader_filename);
-		compile(vertShader, v_src.c_str());
+	Shader::Shader(const char* vertex_shader_filename, const char* tess_control_shader_filename, const char* tess_eval_shader_filename, const char* fragment_shader_filename) :
+		stages{ { GL_VERTEX_SHADER, vertex_shader_filename }, { GL_TESS_CONTROL_SHADER, tess_control_shader_filename },
+			{ GL_TESS_EVALUATION_SHADER, tess_eval_shader_filename }, { GL_FRAGMENT_SHADER, fragment_shader_filename } }
+	{
+		build();
+		use();
+	}
 
-		GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-		std::string f_src = load_source(fragment_shader_filename);
-		compile(fragShader, f_src.c_str());
+	void Shader::build() {
+		std::vector<std::string> sources;
+		for (const Stage& stage : stages)
+			sources.push_back(load_source(stage.filename));
 
+		// A binary from an earlier run on the same driver skips compiling and linking
+		const uint64_t key = binary_key(sources);
 		program = glCreateProgram();
+		if (load_program_binary(program, key)) {
+			reflect_uniforms();
+		}
+		else {
+			// A rejected binary can leave the program in a failed state, start afresh
+			glDeleteProgram(program);
+
+			std::vector<GLuint> shaders;
+			program = start_link(sources, shaders);
+			if (finish_link(program, shaders))
+				save_program_binary(program, key);
+			reflect_uniforms();
+		}
 
-		glAttachShader(program, vertShader);
-		glAttachShader(program, fragShader);
+		if (hot_reload)
+			watch(sources);
+	}
 
-		link();
-		use();
+	uint64_t Shader::binary_key(const std::vector<std::string>& sources) const {
+		std::vector<GLenum> types;
+		for (const Stage& stage : stages)
+			types.push_back(stage.type);
+		return program_binary_key(types.data(), sources.data(), (int)sources.size());
 	}
 
-	Shader::Shader(const char* vertex_shader_filename, const char* fragment_shader_filename, const char* geom_shader_filename) {
-		GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-		std::string v_src = load_source(vertex_shader_filename);
-		compile(vertShader, v_src.c_str());
+	GLuint Shader::start_link(const std::vector<std::string>& sources, std::vector<GLuint>& shaders) const {
+		GLuint p = glCreateProgram();
+		shaders.clear();
+
+		for (size_t i = 0; i < stages.size(); i++) {
+			const char* src = sources[i].c_str();
+			GLuint shader = glCreateShader(stages[i].type);
+			glShaderSource(shader, 1, &src, nullptr);
+			glCompileShader(shader);
+			glAttachShader(p, shader);
+			shaders.push_back(shader);
+		}
 
-		GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-		std::string f_src = load_source(fragment_shader_filename);
-		compile(fragShader, f_src.c_str());
+		glProgramParameteri(p, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(p);
+		return p;
+	}
 
-		GLuint geomShader = glCreateShader(GL_GEOMETRY_SHADER);
-		std::string g_src = load_source(geom_shader_filename);
-		compile(geomShader, g_src.c_str());
+	bool Shader::finish_link(GLuint p, std::vector<GLuint>& shaders) const {
+		GLint status;
+		GLchar infoLog[512];
 
-		program = glCreateProgram();
+		glGetProgramiv(p, GL_LINK_STATUS, &status);
+		if (!status) {
+			for (size_t i = 0; i < shaders.size(); i++) {
+				GLint compiled;
+				glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+				if (!compiled) {
+					glGetShaderInfoLog(shaders[i], 512, nullptr, infoLog);
+					std::cout << stages[i].filename << ": " << infoLog << std::endl;
+				}
+			}
+			glGetProgramInfoLog(p, 512, nullptr, infoLog);
+			std::cout << infoLog << std::endl;
+		}
 
-		glAttachShader(program, vertShader);
-		glAttachShader(program, fragShader);
-		glAttachShader(program, geomShader);
+		// The linked program keeps its own code, the shader objects are dead weight
+		for (GLuint shader : shaders) {
+			glDetachShader(p, shader);
+			glDeleteShader(shader);
+		}
+		shaders.clear();
 
-		link();
-		use();
+		return status == GL_TRUE;
 	}
 
-	Shader::Shader(const char* vertex_shader_filename, const char* tess_control_shader_filename, const char* tess_eval_shader_filename, const char* fragment_shader_filename) {
-		GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-		std::string v_src = load_source(vertex_shader_filename);
-		compile(vertShader, v_src.c_str());
-
-		GLuint tcShader = glCreateShader(GL_TESS_CONTROL_SHADER);
-		std::string tc_src = load_source(tess_control_shader_filename);
-		compile(tcShader, tc_src.c_str());
+	void Shader::watch(const std::vector<std::string>& sources) {
+		// Let the driver compile on its own threads so polling never blocks a frame
+		static bool parallel_compile = false;
+		if (!parallel_compile && GLEW_ARB_parallel_shader_compile) {
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			parallel_compile = true;
+		}
 
-		GLuint teShader = glCreateShader(GL_TESS_EVALUATION_SHADER);
-		std::string te_src = load_source(tess_eval_shader_filename);
-		compile(teShader, te_src.c_str());
+		reloader.reset(new Reloader);
+		reloader->source_hash = hash_sources(sources);
 
-		GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-		std::string f_src = load_source(fragment_shader_filename);
-		compile(fragShader, f_src.c_str());
+		std::vector<std::string> paths;
+		for (const Stage& stage : stages)
+			paths.push_back(stage.filename);
 
-		program = glCreateProgram();
+		Reloader* r = reloader.get();
+		reloader->watcher.reset(new FileWatcher(paths, [this, r] {
+			std::vector<std::string> sources;
+			for (const Stage& stage : stages)
+				sources.push_back(load_source(stage.filename));
 
-		glAttachShader(program, vertShader);
-		glAttachShader(program, tcShader);
-		glAttachShader(program, teShader);
-		glAttachShader(program, fragShader);
+			uint64_t hash = hash_sources(sources);
+			if (hash == r->source_hash)
+				return;
+			r->source_hash = hash;
 
-		link();
-		use();
+			std::lock_guard<std::mutex> lock{ r->mutex };
+			r->sources.swap(sources);
+			r->changed = true;
+		}));
 	}
 
-	void Shader::compile(GLuint shader, const char* src) {
-		GLint status;
-		GLchar infoLog[512];
-		glShaderSource(shader, 1, &src, nullptr);
-		glCompileShader(shader);
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-		if (!status) {
-			glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-			std::cout << infoLog << std::endl;
+	void Shader::poll_reload() {
+		Reloader& r = *reloader;
+
+		if (r.pending) {
+			// Without parallel compile support this reads as complete and the status query below waits
+			GLint complete = GL_TRUE;
+			if (GLEW_ARB_parallel_shader_compile)
+				glGetProgramiv(r.pending, GL_COMPLETION_STATUS_ARB, &complete);
+			if (!complete)
+				return;
+
+			// A bad edit leaves the running program untouched
+			if (finish_link(r.pending, r.pending_shaders)) {
+				glDeleteProgram(program);
+				program = r.pending;
+				reflect_uniforms();
+				save_program_binary(program, binary_key(r.pending_sources));
+				std::cout << "Reloaded " << stages[0].filename << std::endl;
+			}
+			else {
+				glDeleteProgram(r.pending);
+			}
+
+			r.pending = 0;
+			return;
 		}
+
+		if (!r.changed)
+			return;
+
+		std::vector<std::string> sources;
+		{
+			std::lock_guard<std::mutex> lock{ r.mutex };
+			sources.swap(r.sources);
+			r.changed = false;
+		}
+
+		r.pending = start_link(sources, r.pending_shaders);
+		r.pending_sources.swap(sources);
 	}
 
-	void Shader::link() {
-		GLint status;
-		GLchar infoLog[512];
-		glLinkProgram(program);
-		glGetProgramiv(program, GL_LINK_STATUS, &status);
-		if (!status) {
-			glGetProgramInfoLog(program, 512, nullptr, infoLog);
-			std::cout << infoLog << std::endl;
+	void Shader::reflect_uniforms() {
+		GLint count = 0;
+		GLint max_length = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+		uniforms.clear();
+		uniforms.reserve(count);
+
+		std::vector<GLchar> name(max_length + 1);
+		for (GLint i = 0; i < count; i++) {
+			GLint size;
+			GLenum type;
+			GLsizei length;
+			glGetActiveUniform(program, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+			// Uniform block members have no location of their own
+			GLint location = glGetUniformLocation(program, name.data());
+			if (location < 0)
+				continue;
+
+			// Arrays are reported as "name[0]", but are set through the base name
+			std::string entry_name{ name.data(), (size_t)length };
+			if (size > 1 && entry_name.size() > 3 && entry_name.compare(entry_name.size() - 3, 3, "[0]") == 0)
+				entry_name.erase(entry_name.size() - 3);
+
+			uniforms.push_back({ entry_name, location });
 		}
+
+		std::sort(uniforms.begin(), uniforms.end(), [](const UniformEntry& a, const UniformEntry& b) {
+			return a.name < b.name;
+		});
+
+		// Handles given out earlier stay valid across rebuilds
+		for (UniformEntry& handle : handles)
+			handle.location = find_location(handle.name.c_str());
 	}
 
 	void Shader::use() {
+		if (reloader)
+			poll_reload();
 		glUseProgram(program);
 	}
 
@@ -124,46 +278,104 @@ namespace utils {
 	}
 
 	void Shader::destroy() {
+		if (reloader && reloader->pending) {
+			finish_link(reloader->pending, reloader->pending_shaders);
+			glDeleteProgram(reloader->pending);
+		}
+		reloader.reset();
 		glDeleteProgram(program);
 	}
 
 	void Shader::set_uniform(const char* name, const bool b) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform1i(uniform_location, b);
 	}
 
 	void Shader::set_uniform(const char* name, const float v) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform1f(uniform_location, v);
 	}
 
 	void Shader::set_uniform(const char* name, const int i) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform1i(uniform_location, i);
 	}
 
 	void Shader::set_uniform(const char* name, const maths::vec2& v) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform2fv(uniform_location, 1, &v[0]);
 	}
 
 	void Shader::set_uniform(const char* name, const maths::vec3& v) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform3fv(uniform_location, 1, &v[0]);
 	}
 
 	void Shader::set_uniform(const char* name, const maths::vec4& v) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniform4fv(uniform_location, 1, &v[0]);
 	}
 
 	void Shader::set_uniform(const char* name, const maths::mat4& v) {
-		GLuint uniform_location = uniform_handle(name);
+		GLint uniform_location = uniform_handle(name);
 		glUniformMatrix4fv(uniform_location, 1, GL_FALSE, &v[0][0]);
 	}
 
+	void Shader::set_uniform(Uniform u, const bool b) {
+		glUniform1i(location(u), b);
+	}
+
+	void Shader::set_uniform(Uniform u, const float v) {
+		glUniform1f(location(u), v);
+	}
+
+	void Shader::set_uniform(Uniform u, const int i) {
+		glUniform1i(location(u), i);
+	}
+
+	void Shader::set_uniform(Uniform u, const maths::vec2& v) {
+		glUniform2fv(location(u), 1, &v[0]);
+	}
+
+	void Shader::set_uniform(Uniform u, const maths::vec3& v) {
+		glUniform3fv(location(u), 1, &v[0]);
+	}
+
+	void Shader::set_uniform(Uniform u, const maths::vec4& v) {
+		glUniform4fv(location(u), 1, &v[0]);
+	}
+
+	void Shader::set_uniform(Uniform u, const maths::mat4& v) {
+		glUniformMatrix4fv(location(u), 1, GL_FALSE, &v[0][0]);
+	}
+
 	GLint Shader::uniform_handle(const char* name) {
-		return glGetUniformLocation(program, name);
+		string_lookups++;
+		return find_location(name);
+	}
+
+	Uniform Shader::uniform(const char* name) {
+		string_lookups++;
+
+		// Uniforms the program lacks get a handle too, a reload may add them
+		for (size_t i = 0; i < handles.size(); i++) {
+			if (handles[i].name == name)
+				return Uniform{ (int)i };
+		}
+
+		handles.push_back({ name, find_location(name) });
+		return Uniform{ (int)handles.size() - 1 };
+	}
+
+	GLint Shader::find_location(const char* name) const {
+		auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const UniformEntry& e, const char* n) {
+			return std::strcmp(e.name.c_str(), n) < 0;
+		});
+
+		if (it == uniforms.end() || it->name != name)
+			return -1;
+
+		return it->location;
 	}
 
 	std::string Shader::load_source(const char* filename) {
@@ -1,12 +1,26 @@
 #pragma once
 
 #include <GL\glew.h>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "maths.h"
 
 namespace utils {
+	// Uniform resolved once up front, so setting it never touches a string. It
+	// indexes the shader's handle table, whose locations are refreshed whenever
+	// the program is rebuilt.
+	struct Uniform {
+		Uniform() : slot(-1) {}
+		explicit Uniform(int slot) : slot(slot) {}
+
+		int slot;
+	};
+
 	class Shader {
 	public:
 		Shader();
@@ -14,6 +28,10 @@ namespace utils {
 		Shader(const char* vertex_shader_filename, const char* fragment_shader_filename);
 		Shader(const char* vertex_shader_filename, const char* fragment_shader_filename, const char* geom_shader_filename);
 		Shader(const char* vertex_shader_filename, const char* tess_control_shader_filename, const char* tess_eval_shader_filename, const char* fragment_shader_filename);
+		~Shader();
+
+		Shader(const Shader&) = delete;
+		Shader& operator = (const Shader&) = delete;
 
 		void use();
 		void release();
@@ -27,15 +45,67 @@ namespace utils {
 		void set_uniform(const char* name, const maths::vec4& v);
 		void set_uniform(const char* name, const maths::mat4& v);
 
+		void set_uniform(Uniform u, const bool b);
+		void set_uniform(Uniform u, const float v);
+		void set_uniform(Uniform u, const int i);
+		void set_uniform(Uniform u, const maths::vec2& v);
+		void set_uniform(Uniform u, const maths::vec3& v);
+		void set_uniform(Uniform u, const maths::vec4& v);
+		void set_uniform(Uniform u, const maths::mat4& v);
+
 		GLuint program;
 		GLint uniform_handle(const char* name);
+		Uniform uniform(const char* name);
+
+		// Count of by-name uniform lookups, reset by the caller once per frame
+		static unsigned int string_lookups;
+
+		// Watch the source files of shaders created from now on and rebuild them
+		// when they change. Sources are read on a watcher thread, compiled and
+		// linked without blocking the render thread where the driver supports
+		// it, and swapped in by use() only once they link.
+		static bool hot_reload;
 
 	private:
-		std::string load_source(const char* filename);
-		void compile(GLuint shader, const char* src);
-		void link();
+		struct UniformEntry {
+			std::string name;
+			GLint location;
+		};
+
+		struct Stage {
+			GLenum type;
+			const char* filename;
+		};
+
+		struct Reloader;
+
+		// Load the program from the binary cache, or compile and link the stages and cache the result
+		void build();
+		uint64_t binary_key(const std::vector<std::string>& sources) const;
+
+		// Compile sources into a new program and start linking it; finish_link()
+		// waits for the result, logs any errors and frees the shader objects
+		GLuint start_link(const std::vector<std::string>& sources, std::vector<GLuint>& shaders) const;
+		bool finish_link(GLuint p, std::vector<GLuint>& shaders) const;
+
+		void watch(const std::vector<std::string>& sources);
+		void poll_reload();
+
+		static std::string load_source(const char* filename);
+		void reflect_uniforms();
+		GLint find_location(const char* name) const;
+
+		GLint location(Uniform u) const { return u.slot >= 0 ? handles[u.slot].location : -1; }
+
+		// Active uniforms sorted by name, filled after every link
+		std::vector<UniformEntry> uniforms;
+
+		// Uniforms handed out by uniform(), indexed by Uniform::slot
+		std::vector<UniformEntry> handles;
+
+		std::vector<Stage> stages;
 
-		const char* v_shader_filename;
-		const char* f_shader_filename;
+		// Declared after stages, which its watcher thread reads
+		std::unique_ptr<Reloader> reloader;
 	};
 }
@@ -0,0 +1,128 @@
+#include "spectrogram_renderer.h"
+#include "utils.h"
+
+#include <algorithm>
+
+SpectrogramRenderer::SpectrogramRenderer(int num_bands, int history, const maths::vec4& rect, int max_pending) :
+	num_bands(num_bands),
+	history(history),
+	rect(rect),
+	loudness_scale(1.f),
+	colour_quiet(utils::colour::black),
+	colour_loud(utils::colour::red),
+	uploads(0),
+	shader("shaders/v.spectrogram.glsl", "shaders/f.spectrogram.glsl"),
+	write_row(0),
+	pending((size_t)std::max(1, max_pending) * num_bands),
+	max_pending(std::max(1, max_pending)),
+	pending_count(0),
+	pending_row(0)
+{
+	u_projection = shader.uniform("projection");
+	u_rect = shader.uniform("rect");
+	u_scroll = shader.uniform("scroll");
+	u_loudness_scale = shader.uniform("loudness_scale");
+	u_colour_quiet = shader.uniform("colour_quiet");
+	u_colour_loud = shader.uniform("colour_loud");
+	u_history = shader.uniform("history");
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &vbo_quad);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_quad);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(utils::mesh::quad_points_textured), &utils::mesh::quad_points_textured, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	// One band per texel across, one column per row down; half floats keep a
+	// 2048 x 4096 history at 16 MB. Rows wrap, bands clamp.
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, num_bands, history);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Cleared a batch of rows at a time through the pending buffer, which starts zeroed,
+	// so a long history never needs a staging copy of its own
+	for (int row = 0; row < history; row += this->max_pending) {
+		const int rows = std::min(this->max_pending, history - row);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, num_bands, rows, GL_RED, GL_FLOAT, pending.data());
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool SpectrogramRenderer::fits(int num_bands, int history) {
+	GLint max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	return num_bands >= 1 && history >= 1 && num_bands <= max_size && history <= max_size &&
+		(long long)num_bands * history <= max_texels;
+}
+
+void SpectrogramRenderer::push(const float* levels) {
+	if (pending_count == max_pending)
+		upload();
+	if (pending_count == 0)
+		pending_row = write_row;
+
+	std::copy(levels, levels + num_bands, pending.begin() + (size_t)pending_count * num_bands);
+	pending_count++;
+	write_row = (write_row + 1) % history;
+}
+
+void SpectrogramRenderer::upload() {
+	if (pending_count == 0)
+		return;
+
+	// The pending columns are consecutive rows; if more arrived than the ring holds, only the newest survive
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	const int count = std::min(pending_count, history);
+	const int skipped = pending_count - count;
+	const int first_row = (pending_row + skipped) % history;
+	const float* first = pending.data() + (size_t)skipped * num_bands;
+
+	const int before_wrap = std::min(count, history - first_row);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first_row, num_bands, before_wrap, GL_RED, GL_FLOAT, first);
+	uploads++;
+	if (count > before_wrap) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, num_bands, count - before_wrap, GL_RED, GL_FLOAT, first + (size_t)before_wrap * num_bands);
+		uploads++;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pending_count = 0;
+}
+
+void SpectrogramRenderer::draw(const maths::mat4& projection) {
+	shader.use();
+	shader.set_uniform(u_projection, projection);
+	shader.set_uniform(u_rect, rect);
+	shader.set_uniform(u_scroll, (float)write_row / (float)history);
+	shader.set_uniform(u_history, (float)history);
+	shader.set_uniform(u_loudness_scale, loudness_scale);
+	shader.set_uniform(u_colour_quiet, colour_quiet);
+	shader.set_uniform(u_colour_loud, colour_loud);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	shader.release();
+}
+
+void SpectrogramRenderer::destroy() {
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &vbo_quad);
+	glDeleteVertexArrays(1, &vao);
+	shader.destroy();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <vector>
+
+#include "maths.h"
+#include "shader.h"
+
+// Scrolling spectrogram: time runs left to right, newest on the right, and
+// bands bottom to top. Every column lives in one row of a history-tall ring
+// texture, written in place as it arrives; scrolling is only a texture
+// coordinate offset in shaders/f.spectrogram.glsl, so a frame costs the same
+// whatever the history length.
+class SpectrogramRenderer {
+public:
+	// Columns are accumulated on the CPU until upload(), or until max_pending
+	// of them force push() to upload early
+	SpectrogramRenderer(int num_bands, int history, const maths::vec4& rect, int max_pending = 64);
+
+	// 256 MB of half floats
+	static const long long max_texels = 128LL * 1024 * 1024;
+
+	// Whether a num_bands x history texture is within GL_MAX_TEXTURE_SIZE and
+	// max_texels; needs a current context
+	static bool fits(int num_bands, int history);
+
+	// Append one column of num_bands levels, 0 to loudness_scale
+	void push(const float* levels);
+
+	// Write the columns pushed since the last upload into their rows, in one
+	// glTexSubImage2D call, or two where they wrap
+	void upload();
+
+	void draw(const maths::mat4& projection);
+	void destroy();
+
+	int num_bands;
+	int history;
+
+	// x, y, width, height in the projection's units
+	maths::vec4 rect;
+	float loudness_scale;
+
+	maths::vec4 colour_quiet;
+	maths::vec4 colour_loud;
+
+	// glTexSubImage2D calls issued
+	unsigned int uploads;
+
+private:
+	utils::Shader shader;
+	utils::Uniform u_projection;
+	utils::Uniform u_rect;
+	utils::Uniform u_scroll;
+	utils::Uniform u_loudness_scale;
+	utils::Uniform u_colour_quiet;
+	utils::Uniform u_colour_loud;
+	utils::Uniform u_history;
+
+	GLuint vao;
+	GLuint vbo_quad;
+	GLuint texture;
+
+	// Next ring row to write; rows before it are the newest
+	int write_row;
+
+	// Columns waiting for upload(), destined for the rows from pending_row on
+	std::vector<float> pending;
+	int max_pending;
+	int pending_count;
+	int pending_row;
+};
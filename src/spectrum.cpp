@@ -0,0 +1,284 @@
+#include "spectrum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpu.h"
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#elif defined(CPU_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace dsp {
+	void mix_to_mono(const float* interleaved, int frames, int channels, float* out) {
+		const float gain = 1.f / (float)channels;
+		for (int i = 0; i < frames; i++) {
+			float sum = 0.f;
+			for (int c = 0; c < channels; c++)
+				sum += interleaved[i * channels + c];
+			out[i] = sum * gain;
+		}
+	}
+
+	void update_bins(float* fft, int fft_samples, float* bins, float* oldbins, int num_bins, float scale) {
+		const float sample_range = (float)fft_samples / (float)num_bins;
+
+		for (int i = 0; i < fft_samples; i++)
+			fft[i] = sqrtf(fft[i]);
+
+		// Normalise FFT values for consistent scaling
+		float max_fft = 0.f;
+		for (int i = 0; i < fft_samples; i++)
+			if (fft[i] > max_fft)
+				max_fft = fft[i];
+		if (max_fft > 0.f)
+			for (int i = 0; i < fft_samples; i++)
+				fft[i] = (fft[i] / max_fft) * scale;
+
+		// Update the old bins
+		std::copy(bins, bins + num_bins, oldbins);
+
+		// Update the new bins
+		for (int i = 0; i < num_bins; i++) {
+			// Reset the bin array representing next FFT samples
+			bins[i] = 0.f;
+
+			// Get upper and lower values for FFT sampling
+			int lower = (int)roundf(sample_range * (float)(i));
+			int upper = (int)roundf(sample_range * (float)(i + 1));
+
+			// Average of FFT values is the new value for that bin
+			for (int j = lower; j < upper; j++)
+				bins[i] += fft[j];
+			int sample_count = upper - lower;
+			if (sample_count > 0)
+				bins[i] /= static_cast<float>(sample_count);
+
+			// Average the new bin value with the previous value for smoother display
+			bins[i] = (bins[i] + oldbins[i]) * 0.5f;
+		}
+	}
+
+	// Scalar kernels, also used for the tails of the vector ones
+
+	// Weighted sum of band i, weights already include the 1 / width averaging
+	static float bin_sum(const BinKernel& k, const float* in, int i) {
+		const float* p = in + k.map.start[i];
+		const float* w = &k.map.weights[k.map.offset[i]];
+		float sum = 0.f;
+		for (int j = 0; j < k.map.count[i]; j++)
+			sum += p[j] * w[j];
+		return sum;
+	}
+
+	static float sqrt_max_scalar(const float* in, float* out, int n) {
+		float max_v = 0.f;
+		for (int i = 0; i < n; i++) {
+			out[i] = sqrtf(in[i]);
+			max_v = std::max(max_v, out[i]);
+		}
+		return max_v;
+	}
+
+	static void bands_scalar_from(const BinKernel& k, int first, const float* in, float norm, float* out) {
+		for (int i = first; i < k.num_bins; i++)
+			out[i] = bin_sum(k, in, i) * norm;
+	}
+
+#if !defined(CPU_X86) && !defined(CPU_NEON)
+	static void bands_scalar(const BinKernel& k, const float* in, float norm, float* out) {
+		bands_scalar_from(k, 0, in, norm, out);
+	}
+#endif
+
+#if defined(CPU_X86) || defined(CPU_NEON)
+	// Sample and weight j of bands i to i + 3, zero past a band's end. Neither SSE2
+	// nor NEON can gather, so the lanes are loaded one at a time and only the
+	// multiply-adds are vectorised; the sums add in the same order as bin_sum.
+	struct BandLanes {
+		const float* p[4];
+		const float* w[4];
+		int count[4];
+		int width;
+
+		BandLanes(const BinKernel& k, const float* in, int i) : width(0) {
+			for (int l = 0; l < 4; l++) {
+				p[l] = in + k.map.start[i + l];
+				w[l] = &k.map.weights[k.map.offset[i + l]];
+				count[l] = k.map.count[i + l];
+				width = std::max(width, count[l]);
+			}
+		}
+
+		float sample(int l, int j) const { return j < count[l] ? p[l][j] : 0.f; }
+		float weight(int l, int j) const { return j < count[l] ? w[l][j] : 0.f; }
+	};
+#endif
+
+#if defined(CPU_X86)
+	static float sqrt_max_sse2(const float* in, float* out, int n) {
+		__m128 vmax = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128 v = _mm_sqrt_ps(_mm_loadu_ps(in + i));
+			_mm_storeu_ps(out + i, v);
+			vmax = _mm_max_ps(vmax, v);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, vmax);
+		float max_v = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		return std::max(max_v, sqrt_max_scalar(in + i, out + i, n - i));
+	}
+
+	static void bands_sse2(const BinKernel& k, const float* in, float norm, float* out) {
+		const __m128 vnorm = _mm_set1_ps(norm);
+
+		int i = 0;
+		for (; i + 4 <= k.num_bins; i += 4) {
+			BandLanes b(k, in, i);
+			__m128 sum = _mm_setzero_ps();
+			for (int j = 0; j < b.width; j++) {
+				__m128 v = _mm_setr_ps(b.sample(0, j), b.sample(1, j), b.sample(2, j), b.sample(3, j));
+				__m128 w = _mm_setr_ps(b.weight(0, j), b.weight(1, j), b.weight(2, j), b.weight(3, j));
+				sum = _mm_add_ps(sum, _mm_mul_ps(v, w));
+			}
+			_mm_storeu_ps(out + i, _mm_mul_ps(sum, vnorm));
+		}
+		bands_scalar_from(k, i, in, norm, out);
+	}
+
+	CPU_TARGET_AVX2 static float sqrt_max_avx2(const float* in, float* out, int n) {
+		__m256 vmax = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 v = _mm256_sqrt_ps(_mm256_loadu_ps(in + i));
+			_mm256_storeu_ps(out + i, v);
+			vmax = _mm256_max_ps(vmax, v);
+		}
+
+		float lanes[8];
+		_mm256_storeu_ps(lanes, vmax);
+		float max_v = *std::max_element(lanes, lanes + 8);
+		return std::max(max_v, sqrt_max_scalar(in + i, out + i, n - i));
+	}
+
+	// Eight bands at a time: one masked gather of samples and weights per position within the widest band of the group
+	CPU_TARGET_AVX2 static void bands_avx2(const BinKernel& k, const float* in, float norm, float* out) {
+		const __m256 vnorm = _mm256_set1_ps(norm);
+
+		int i = 0;
+		for (; i + 8 <= k.num_bins; i += 8) {
+			__m256i start = _mm256_loadu_si256((const __m256i*)&k.map.start[i]);
+			__m256i offset = _mm256_loadu_si256((const __m256i*)&k.map.offset[i]);
+			__m256i count = _mm256_loadu_si256((const __m256i*)&k.map.count[i]);
+			__m256 sum = _mm256_setzero_ps();
+
+			const int width = k.map.group_width[i / 8];
+			for (int j = 0; j < width; j++) {
+				__m256i vj = _mm256_set1_epi32(j);
+				__m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(count, vj));
+				__m256 v = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), in, _mm256_add_epi32(start, vj), mask, 4);
+				__m256 w = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), k.map.weights.data(), _mm256_add_epi32(offset, vj), mask, 4);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(v, w));
+			}
+
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(sum, vnorm));
+		}
+		bands_scalar_from(k, i, in, norm, out);
+	}
+#elif defined(CPU_NEON)
+	static float sqrt_max_neon(const float* in, float* out, int n) {
+		int i = 0;
+		float max_v = 0.f;
+#if defined(__aarch64__) || defined(_M_ARM64)
+		float32x4_t vmax = vdupq_n_f32(0.f);
+		for (; i + 4 <= n; i += 4) {
+			float32x4_t v = vsqrtq_f32(vld1q_f32(in + i));
+			vst1q_f32(out + i, v);
+			vmax = vmaxq_f32(vmax, v);
+		}
+		max_v = vmaxvq_f32(vmax);
+#endif
+		return std::max(max_v, sqrt_max_scalar(in + i, out + i, n - i));
+	}
+
+	static void bands_neon(const BinKernel& k, const float* in, float norm, float* out) {
+		const float32x4_t vnorm = vdupq_n_f32(norm);
+
+		int i = 0;
+		for (; i + 4 <= k.num_bins; i += 4) {
+			BandLanes b(k, in, i);
+			float32x4_t sum = vdupq_n_f32(0.f);
+			for (int j = 0; j < b.width; j++) {
+				float v[4] = { b.sample(0, j), b.sample(1, j), b.sample(2, j), b.sample(3, j) };
+				float w[4] = { b.weight(0, j), b.weight(1, j), b.weight(2, j), b.weight(3, j) };
+				sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(v), vld1q_f32(w)));
+			}
+			vst1q_f32(out + i, vmulq_f32(sum, vnorm));
+		}
+		bands_scalar_from(k, i, in, norm, out);
+	}
+#endif
+
+	BinKernel::BinKernel(int fft_samples, int num_bins, float scale) :
+		BinKernel(BandMap(BandScale::linear, fft_samples, num_bins, 0.f), scale)
+	{
+	}
+
+	BinKernel::BinKernel(const BandMap& map, float scale) :
+		fft_samples(map.fft_samples),
+		num_bins(map.num_bands),
+		scale(scale),
+		map(map),
+		roots(map.fft_samples),
+		sums(map.num_bands)
+	{
+		select_isa();
+	}
+
+	void BinKernel::select_isa() {
+#if defined(CPU_X86)
+		if (utils::cpu_has_avx2()) {
+			isa = "avx2";
+			sqrt_max = sqrt_max_avx2;
+			bands = bands_avx2;
+		}
+		else {
+			isa = "sse2";
+			sqrt_max = sqrt_max_sse2;
+			bands = bands_sse2;
+		}
+#elif defined(CPU_NEON)
+		isa = "neon";
+		sqrt_max = sqrt_max_neon;
+		bands = bands_neon;
+#else
+		isa = "scalar";
+		sqrt_max = sqrt_max_scalar;
+		bands = bands_scalar;
+#endif
+	}
+
+	void BinKernel::process(const float* magnitudes, float* bins, float* oldbins) {
+		float max_v = sqrt_max(magnitudes, roots.data(), fft_samples);
+
+		// Peak normalisation is applied once per band rather than per sample
+		float norm = max_v > 0.f ? scale / max_v : 1.f;
+		bands(*this, roots.data(), norm, sums.data());
+
+		for (int i = 0; i < num_bins; i++) {
+			float old = bins[i];
+			oldbins[i] = old;
+			bins[i] = (sums[i] + old) * 0.5f;
+		}
+	}
+
+	void BinKernel::levels(const float* magnitudes, float* out) {
+		float max_v = sqrt_max(magnitudes, roots.data(), fft_samples);
+		float norm = max_v > 0.f ? 1.f / max_v : 1.f;
+		bands(*this, roots.data(), norm, out);
+	}
+}
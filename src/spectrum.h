@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "band_map.h"
+
+namespace dsp {
+	// Average interleaved frames across channels into out
+	void mix_to_mono(const float* interleaved, int frames, int channels, float* out);
+
+	// Turn raw FFT magnitudes into smoothed bar lengths. fft is rescaled in place,
+	// bins receives the new values and oldbins the previous ones. Scalar
+	// reference for BinKernel, which produces the same result.
+	void update_bins(float* fft, int fft_samples, float* bins, float* oldbins, int num_bins, float scale);
+
+	// The update_bins pipeline over a precomputed band map: a sqrt + peak scan,
+	// then the sparse band product + normalise, which levels() stops after and
+	// process() follows with smoothing. The widest instruction set the CPU
+	// supports is picked at construction.
+	class BinKernel {
+	public:
+		// Linear bands, identical to update_bins
+		BinKernel(int fft_samples, int num_bins, float scale);
+		BinKernel(const BandMap& map, float scale);
+
+		void process(const float* magnitudes, float* bins, float* oldbins);
+
+		// Each band relative to the frame's peak (0-1, independent of scale), the
+		// stored representation the bar dynamics and spectrum cache work from
+		void levels(const float* magnitudes, float* out);
+
+		int fft_samples;
+		int num_bins;
+		float scale;
+
+		// Selected implementation: "avx2", "sse2", "neon" or "scalar"
+		const char* isa;
+
+		BandMap map;
+
+	private:
+		typedef float (*SqrtMaxFn)(const float* in, float* out, int n);
+		typedef void (*BandsFn)(const BinKernel& k, const float* in, float norm, float* out);
+
+		void select_isa();
+
+		SqrtMaxFn sqrt_max;
+		BandsFn bands;
+
+		std::vector<float> roots;
+		std::vector<float> sums;
+	};
+}
@@ -0,0 +1,292 @@
+#include "spectrum_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "atomic_file.h"
+#include "hash.h"
+#include "spectrum.h"
+#include "stft.h"
+#include "thread_pool.h"
+
+namespace dsp {
+	static const char cache_magic[4] = { 'A', 'V', 'S', 'C' };
+	static const uint32_t cache_version = 2;
+	static const int block_frames = 64;
+
+	uint64_t source_fingerprint(const char* path) {
+		utils::MappedFile file{ path };
+		if (!file.is_open())
+			return 0;
+
+		const size_t page = 4096;
+		const int samples = 16;
+
+		uint64_t size = file.size;
+		uint64_t hash = utils::fnv1a(utils::fnv1a_seed, &size, sizeof(size));
+		for (int i = 0; i <= samples; i++) {
+			size_t offset = (size_t)((file.size - std::min(file.size, page)) * (uint64_t)i / samples);
+			hash = utils::fnv1a(hash, file.data + offset, std::min(page, file.size - offset));
+		}
+		return hash;
+	}
+
+	uint64_t band_map_fingerprint(const BandMap& map) {
+		uint64_t hash = utils::fnv1a_seed;
+		hash = utils::fnv1a(hash, map.start.data(), map.start.size() * sizeof(int));
+		hash = utils::fnv1a(hash, map.count.data(), map.count.size() * sizeof(int));
+		hash = utils::fnv1a(hash, map.weights.data(), map.weights.size() * sizeof(float));
+		return hash;
+	}
+
+	static void put_varint(std::vector<unsigned char>& out, uint32_t v) {
+		while (v >= 0x80) {
+			out.push_back((unsigned char)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((unsigned char)v);
+	}
+
+	static bool get_varint(const unsigned char*& p, const unsigned char* end, uint32_t& v) {
+		v = 0;
+		for (int shift = 0; shift < 32 && p < end; shift += 7) {
+			unsigned char byte = *p++;
+			v |= (uint32_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+	static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+	// One worker's share of each block: frames interleaved between shares, each
+	// with its own FFT and kernel so the shares never touch the same state
+	struct CacheShare {
+		CacheShare(int fft_size, Window window, float kaiser_beta, const BandMap& map) :
+			fft(fft_size, window, kaiser_beta), kernel(map, 1.f), magnitudes(fft_size / 2) {}
+
+		void analyse(const float* windows, int fft_size, float* levels, int num_bands, int first, int last, int stride) {
+			for (int frame = first; frame < last; frame += stride) {
+				fft.magnitudes(&windows[(size_t)frame * fft_size], magnitudes.data());
+				kernel.levels(magnitudes.data(), &levels[(size_t)frame * num_bands]);
+			}
+		}
+
+		FFT fft;
+		BinKernel kernel;
+		std::vector<float> magnitudes;
+	};
+
+	bool write_spectrum_cache(const char* path, Decoder& decoder, int fft_size, int hop_size, Window window, float kaiser_beta,
+		const BandMap& map, uint64_t source_hash, const std::atomic<bool>* cancel, int num_threads) {
+		utils::AtomicFile out(path);
+		if (!out.is_open())
+			return false;
+		FILE* file = out.file;
+
+		const int channels = std::max(1, decoder.channels);
+		const int num_bands = map.num_bands;
+
+		if (num_threads <= 0)
+			num_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+		num_threads = std::min(num_threads, block_frames);
+
+		// The STFT only cuts the windows, a block of them is transformed at once
+		STFT stft{ fft_size, hop_size, (float)decoder.sample_rate, window, kaiser_beta, 4, false };
+
+		std::vector<float> interleaved((size_t)hop_size * channels);
+		std::vector<float> mono(hop_size);
+		std::vector<float> windows((size_t)block_frames * fft_size);
+		std::vector<float> levels((size_t)block_frames * num_bands);
+
+		std::vector<std::unique_ptr<CacheShare>> shares;
+		for (int i = 0; i < num_threads; i++)
+			shares.emplace_back(new CacheShare{ fft_size, window, kaiser_beta, map });
+		std::unique_ptr<utils::ThreadPool> pool;
+		if (num_threads > 1)
+			pool.reset(new utils::ThreadPool{ num_threads });
+
+		std::vector<uint16_t> previous(num_bands);
+		std::vector<uint16_t> current(num_bands);
+		std::vector<unsigned char> block;
+		std::vector<uint64_t> offsets;
+
+		SpectrumCacheHeader header = {};
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		uint64_t offset = sizeof(header);
+		uint64_t num_frames = 0;
+		bool ended = false;
+
+		while (ok && !ended) {
+			if (cancel && *cancel) {
+				ok = false;
+				break;
+			}
+
+			// One block of frames, each one hop further into the track. Frame 0 is
+			// the silent window before the track starts, the STFT supplies the rest.
+			const int first = num_frames == 0 ? 1 : 0;
+			int frames_in_block = first;
+			for (; frames_in_block < block_frames; frames_in_block++) {
+				int frames = decoder.read(interleaved.data(), hop_size);
+				if (frames > 0) {
+					mix_to_mono(interleaved.data(), frames, channels, mono.data());
+					stft.push(mono.data(), frames);
+				}
+
+				SpectrumFrame* frame = stft.front();
+				if (!frame) {
+					ended = true;
+					break;
+				}
+				std::copy(frame->samples.begin(), frame->samples.end(), windows.begin() + (size_t)frames_in_block * fft_size);
+				stft.pop();
+			}
+
+			if (first)
+				std::fill(levels.begin(), levels.begin() + num_bands, 0.f);
+			if (pool) {
+				for (int i = 0; i < num_threads; i++) {
+					CacheShare* share = shares[i].get();
+					pool->submit([&, share, i] {
+						share->analyse(windows.data(), fft_size, levels.data(), num_bands, first + i, frames_in_block, num_threads);
+					});
+				}
+				pool->wait();
+			}
+			else {
+				shares[0]->analyse(windows.data(), fft_size, levels.data(), num_bands, first, frames_in_block, 1);
+			}
+
+			block.clear();
+			std::fill(previous.begin(), previous.end(), (uint16_t)0);
+			for (int f = 0; f < frames_in_block; f++) {
+				const float* frame_levels = &levels[(size_t)f * num_bands];
+				for (int i = 0; i < num_bands; i++) {
+					current[i] = (uint16_t)(std::min(std::max(frame_levels[i], 0.f), 1.f) * 65535.f + 0.5f);
+					put_varint(block, zigzag((int32_t)current[i] - (int32_t)previous[i]));
+				}
+				previous.swap(current);
+			}
+			num_frames += frames_in_block;
+
+			if (frames_in_block > 0) {
+				offsets.push_back(offset);
+				ok = fwrite(block.data(), 1, block.size(), file) == block.size();
+				offset += block.size();
+			}
+		}
+
+		// Block table, with the end of the last block as a final entry
+		offsets.push_back(offset);
+		if (ok)
+			ok = fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+
+		memcpy(header.magic, cache_magic, sizeof(cache_magic));
+		header.version = cache_version;
+		header.fft_size = (uint32_t)fft_size;
+		header.hop_size = (uint32_t)hop_size;
+		header.num_bands = (uint32_t)num_bands;
+		header.band_scale = (uint32_t)map.scale;
+		header.sample_rate = (float)decoder.sample_rate;
+		header.block_frames = (uint32_t)block_frames;
+		header.window = (uint32_t)window;
+		header.kaiser_beta = kaiser_beta;
+		header.num_frames = num_frames;
+		header.band_map_hash = band_map_fingerprint(map);
+		header.source_hash = source_hash;
+		header.index_offset = offset;
+
+		if (ok)
+			ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+		return out.commit(ok);
+	}
+
+	SpectrumCache::SpectrumCache(const char* path, uint64_t source_hash, int fft_size, int hop_size, Window window, float kaiser_beta, const BandMap& map) :
+		num_bands(map.num_bands),
+		num_frames(0),
+		frames_per_second(0.0),
+		file(path),
+		header(nullptr),
+		index(nullptr),
+		decoded_block(-1)
+	{
+		if (!file.is_open() || file.size < sizeof(SpectrumCacheHeader))
+			return;
+
+		const SpectrumCacheHeader* h = (const SpectrumCacheHeader*)file.data;
+		if (memcmp(h->magic, cache_magic, sizeof(cache_magic)) != 0 || h->version != cache_version)
+			return;
+
+		if (h->source_hash != source_hash || h->fft_size != (uint32_t)fft_size || h->hop_size != (uint32_t)hop_size ||
+			h->window != (uint32_t)window || (window == Window::kaiser && h->kaiser_beta != kaiser_beta) ||
+			h->num_bands != (uint32_t)map.num_bands || h->band_scale != (uint32_t)map.scale ||
+			h->sample_rate != map.sample_rate || h->band_map_hash != band_map_fingerprint(map) || h->block_frames == 0)
+			return;
+
+		uint64_t num_blocks = (h->num_frames + h->block_frames - 1) / h->block_frames;
+		if (h->index_offset < sizeof(SpectrumCacheHeader) || h->index_offset > file.size ||
+			(file.size - h->index_offset) / sizeof(uint64_t) < num_blocks + 1)
+			return;
+
+		header = h;
+		index = file.data + h->index_offset;
+		num_frames = (long long)h->num_frames;
+		frames_per_second = (double)h->sample_rate / (double)h->hop_size;
+		block_levels.resize((size_t)h->block_frames * num_bands);
+	}
+
+	bool SpectrumCache::decode_block(long long block) {
+		uint64_t begin, end;
+		memcpy(&begin, index + block * sizeof(uint64_t), sizeof(uint64_t));
+		memcpy(&end, index + (block + 1) * sizeof(uint64_t), sizeof(uint64_t));
+		if (begin > end || end > header->index_offset)
+			return false;
+
+		// Partly overwritten if decoding fails below
+		decoded_block = -1;
+
+		const unsigned char* p = file.data + begin;
+		const unsigned char* stop = file.data + end;
+		long long frames = std::min<long long>(header->block_frames, num_frames - block * header->block_frames);
+
+		for (long long f = 0; f < frames; f++) {
+			uint16_t* levels = &block_levels[(size_t)f * num_bands];
+			const uint16_t* previous = f > 0 ? levels - num_bands : nullptr;
+
+			for (int i = 0; i < num_bands; i++) {
+				uint32_t v;
+				if (!get_varint(p, stop, v))
+					return false;
+				levels[i] = (uint16_t)((previous ? previous[i] : 0) + unzigzag(v));
+			}
+		}
+
+		decoded_block = block;
+		return true;
+	}
+
+	bool SpectrumCache::levels_at(double time, float* out) {
+		if (!header)
+			return false;
+
+		long long frame = std::max(0LL, (long long)(time * frames_per_second));
+		if (frame >= num_frames)
+			return false;
+
+		long long block = frame / header->block_frames;
+		if (block != decoded_block && !decode_block(block))
+			return false;
+
+		const uint16_t* levels = &block_levels[(size_t)(frame % header->block_frames) * num_bands];
+		for (int i = 0; i < num_bands; i++)
+			out[i] = (float)levels[i] * (1.f / 65535.f);
+		return true;
+	}
+}
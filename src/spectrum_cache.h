@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "band_map.h"
+#include "decoder.h"
+#include "fft.h"
+#include "mapped_file.h"
+
+namespace dsp {
+	// On-disk band levels for a whole track, so repeat plays need no decoding or FFTs.
+	//
+	// Layout (little-endian): SpectrumCacheHeader, then blocks of block_frames
+	// frames, then a table of block_count + 1 uint64 block offsets. A frame is
+	// num_bands levels quantised to uint16. Within a block, each frame is stored
+	// as zigzag varint deltas against the previous frame (the first against
+	// zero), so any timestamp only needs its own block decoded.
+	struct SpectrumCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t fft_size;
+		uint32_t hop_size;
+		uint32_t num_bands;
+		uint32_t band_scale;
+		float sample_rate;
+		uint32_t block_frames;
+		uint32_t window;
+		float kaiser_beta;
+		uint64_t num_frames;
+		uint64_t band_map_hash;
+		uint64_t source_hash;
+		uint64_t index_offset;
+	};
+
+	// Cheap content hash of a file: its size plus a handful of sampled pages, so
+	// it costs the same for a 3 minute single as for a 2 hour set
+	uint64_t source_fingerprint(const char* path);
+
+	// Hash of the band layout, a cache is only valid for the map it was built with
+	uint64_t band_map_fingerprint(const BandMap& map);
+
+	// Decode the whole track through an STFT and write its cache to path, via a
+	// temporary file so readers never see a partial one. Frame k is the window of
+	// mono samples ending at k * hop_size. The FFTs are spread over num_threads
+	// (0 means one per hardware thread) with identical output for any count.
+	// Returns false on error or if cancel was set.
+	bool write_spectrum_cache(const char* path, Decoder& decoder, int fft_size, int hop_size, Window window, float kaiser_beta,
+		const BandMap& map, uint64_t source_hash, const std::atomic<bool>* cancel = nullptr, int num_threads = 1);
+
+	// Memory-mapped reader. is_open() is false if the file is missing, corrupt
+	// or was built for a different source, FFT, hop, window or band map.
+	class SpectrumCache {
+	public:
+		SpectrumCache(const char* path, uint64_t source_hash, int fft_size, int hop_size, Window window, float kaiser_beta, const BandMap& map);
+
+		bool is_open() const { return header != nullptr; }
+
+		// Levels (num_bands floats, 0-1) of the frame playing at time seconds; false past the end
+		bool levels_at(double time, float* out);
+
+		int num_bands;
+		long long num_frames;
+		double frames_per_second;
+
+	private:
+		bool decode_block(long long block);
+
+		utils::MappedFile file;
+		const SpectrumCacheHeader* header;
+		const unsigned char* index;
+
+		long long decoded_block;
+		std::vector<uint16_t> block_levels;
+	};
+}
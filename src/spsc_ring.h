@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+	// Wait-free single-producer/single-consumer ring. Slots are preallocated and
+	// written in place: the producer fills back() then publish()es it, the
+	// consumer reads front() (or latest()) then pop()s it. Capacity is rounded up
+	// to a power of two and one slot is always left empty.
+	template <typename T>
+	class SpscRing {
+	public:
+		explicit SpscRing(size_t capacity) : head(0), tail(0) {
+			size_t n = 2;
+			while (n < capacity)
+				n <<= 1;
+			slots.resize(n);
+			mask = n - 1;
+		}
+
+		// Preallocated storage, for sizing slots before either thread starts
+		std::vector<T>& storage() { return slots; }
+
+		// Producer: next free slot, or nullptr when the consumer has fallen behind
+		T* back() {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (((h + 1) & mask) == tail.load(std::memory_order_acquire))
+				return nullptr;
+			return &slots[h];
+		}
+
+		void publish() {
+			size_t h = head.load(std::memory_order_relaxed);
+			head.store((h + 1) & mask, std::memory_order_release);
+		}
+
+		// Consumer: oldest unread slot, or nullptr when empty
+		T* front() {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t == head.load(std::memory_order_acquire))
+				return nullptr;
+			return &slots[t];
+		}
+
+		// Consumer: discard everything but the newest slot and return it
+		T* latest() {
+			size_t h = head.load(std::memory_order_acquire);
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t == h)
+				return nullptr;
+			size_t newest = (h - 1) & mask;
+			tail.store(newest, std::memory_order_release);
+			return &slots[newest];
+		}
+
+		void pop() {
+			size_t t = tail.load(std::memory_order_relaxed);
+			tail.store((t + 1) & mask, std::memory_order_release);
+		}
+
+	private:
+		static const size_t cache_line = 64;
+
+		// Padding rather than alignas keeps the indices on separate cache lines
+		// without needing over-aligned allocation for heap-held rings
+		char pad_front[cache_line];
+		std::atomic<size_t> head;
+		char pad_head[cache_line - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> tail;
+		char pad_tail[cache_line - sizeof(std::atomic<size_t>)];
+		size_t mask;
+		std::vector<T> slots;
+	};
+}
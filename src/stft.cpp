@@ -0,0 +1,125 @@
+#include "stft.h"
+#include "audio_features.h"
+#include "spectrum.h"
+
+#include <algorithm>
+
+namespace dsp {
+	STFT::STFT(int size, int hop, float sample_rate, Window window, float kaiser_beta, int queue_frames, bool transform) :
+		size(size),
+		hop(hop),
+		num_bins(size / 2),
+		sample_rate(sample_rate),
+		transform(transform),
+		dropped_frames(0),
+		fft(size, window, kaiser_beta),
+		history(size * 2, 0.f),
+		write_pos(0),
+		until_hop(hop),
+		position(0),
+		queue(queue_frames),
+		has_previous(false)
+	{
+		for (SpectrumFrame& frame : queue.storage()) {
+			if (transform)
+				frame.magnitudes.resize(num_bins);
+			else
+				frame.samples.resize(size);
+			frame.time = 0.0;
+		}
+		previous.magnitudes.resize(num_bins);
+		previous.time = 0.0;
+	}
+
+	void STFT::push(const float* samples, int count) {
+		while (count > 0) {
+			int n = std::min(count, until_hop);
+
+			for (int i = 0; i < n; i++) {
+				history[write_pos] = samples[i];
+				history[write_pos + size] = samples[i];
+				write_pos = (write_pos + 1 == size) ? 0 : write_pos + 1;
+			}
+
+			samples += n;
+			count -= n;
+			position += n;
+			until_hop -= n;
+
+			if (until_hop == 0) {
+				until_hop = hop;
+
+				SpectrumFrame* frame = queue.back();
+				if (!frame) {
+					dropped_frames++;
+					continue;
+				}
+
+				if (transform)
+					fft.magnitudes(&history[write_pos], frame->magnitudes.data());
+				else
+					std::copy(&history[write_pos], &history[write_pos] + size, frame->samples.begin());
+				frame->time = (double)position / sample_rate;
+				queue.publish();
+			}
+		}
+	}
+
+	bool STFT::sample(double time, float* out) {
+		// Keep the newest frame at or before time; swapping buffers with the slot avoids a copy
+		while (SpectrumFrame* frame = queue.front()) {
+			if (frame->time > time)
+				break;
+			previous.magnitudes.swap(frame->magnitudes);
+			previous.time = frame->time;
+			has_previous = true;
+			queue.pop();
+		}
+
+		if (!has_previous)
+			return false;
+
+		const SpectrumFrame* next = queue.front();
+		if (!next || next->time <= previous.time) {
+			std::copy(previous.magnitudes.begin(), previous.magnitudes.end(), out);
+			return true;
+		}
+
+		const float t = (float)std::min(1.0, std::max(0.0, (time - previous.time) / (next->time - previous.time)));
+		for (int i = 0; i < num_bins; i++)
+			out[i] = previous.magnitudes[i] + (next->magnitudes[i] - previous.magnitudes[i]) * t;
+		return true;
+	}
+
+	AnalysisTap::AnalysisTap(Decoder& source, STFT& stft) :
+		AnalysisTap(source, &stft, nullptr)
+	{
+	}
+
+	AnalysisTap::AnalysisTap(Decoder& source, STFT* stft, FeatureAnalyser* features) :
+		source(source),
+		stft(stft),
+		features(features),
+		mono(4096)
+	{
+		sample_rate = source.sample_rate;
+		channels = source.channels;
+		length = source.length;
+	}
+
+	int AnalysisTap::read(float* out, int frames) {
+		frames = source.read(out, frames);
+
+		// Mix down in mono-sized pieces so large reads never reallocate
+		const int chunk = (int)mono.size();
+		for (int done = 0; done < frames; done += chunk) {
+			int n = std::min(chunk, frames - done);
+			mix_to_mono(out + (size_t)done * channels, n, channels, mono.data());
+			if (stft)
+				stft->push(mono.data(), n);
+			if (features)
+				features->push(mono.data(), n);
+		}
+		return frames;
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "decoder.h"
+#include "fft.h"
+#include "spsc_ring.h"
+
+namespace dsp {
+	class FeatureAnalyser;
+
+	struct SpectrumFrame {
+		std::vector<float> magnitudes;
+		std::vector<float> samples;		// The unwindowed input instead, from an STFT without a transform
+		double time;
+	};
+
+	// Sliding-window STFT over a continuous mono stream. Every hop samples the
+	// newest size samples are windowed and transformed into a preallocated queue
+	// slot, so analysis keeps its own rate whatever the display does. push() is
+	// the producer side and may run on another thread to the consumer calls.
+	// Without transform, frames carry the raw window in samples for a GPU
+	// transform (GpuSpectrum) and sample() is not used.
+	class STFT {
+	public:
+		STFT(int size, int hop, float sample_rate, Window window = Window::hann, float kaiser_beta = 8.6f, int queue_frames = 64, bool transform = true);
+
+		// Producer: append samples, queueing a frame each time another hop completes
+		void push(const float* samples, int count);
+
+		// Consumer: oldest queued frame or nullptr, then pop() it
+		SpectrumFrame* front() { return queue.front(); }
+		void pop() { queue.pop(); }
+
+		// Consumer: magnitudes at time seconds, interpolated between the queued
+		// frames either side of it. Frames before time are consumed. False until
+		// the first frame has arrived.
+		bool sample(double time, float* out);
+
+		int size;
+		int hop;
+		int num_bins;
+		float sample_rate;
+		bool transform;
+
+		// Frames lost because the consumer let the queue fill up; counted on the producer's thread
+		std::atomic<unsigned int> dropped_frames;
+
+	private:
+		FFT fft;
+
+		// Each sample is stored twice, size apart, so the current window is
+		// always the contiguous run history[write_pos, write_pos + size)
+		std::vector<float> history;
+		int write_pos;
+		int until_hop;
+		long long position;
+
+		utils::SpscRing<SpectrumFrame> queue;
+		SpectrumFrame previous;
+		bool has_previous;
+	};
+
+	// Decoder decorator that feeds everything read through it, mixed to mono, to
+	// an STFT and/or a FeatureAnalyser. Put it between a decoder and playback to
+	// analyse exactly the PCM that is played, once.
+	class AnalysisTap : public Decoder {
+	public:
+		AnalysisTap(Decoder& source, STFT& stft);
+
+		// Either may be nullptr
+		AnalysisTap(Decoder& source, STFT* stft, FeatureAnalyser* features);
+
+		int read(float* out, int frames) override;
+
+	private:
+		Decoder& source;
+		STFT* stft;
+		FeatureAnalyser* features;
+		std::vector<float> mono;
+	};
+}
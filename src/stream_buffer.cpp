@@ -0,0 +1,58 @@
+#include "stream_buffer.h"
+
+namespace utils {
+	StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr segment_size, int num_segments) :
+		target(target),
+		segment_size(segment_size),
+		num_segments(num_segments),
+		segment(num_segments - 1),
+		stalls(0),
+		fences(num_segments, nullptr)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+		glBufferStorage(target, segment_size * num_segments, nullptr, flags);
+		mapped = (char*)glMapBufferRange(target, 0, segment_size * num_segments, flags);
+		glBindBuffer(target, 0);
+	}
+
+	void* StreamBuffer::map_next() {
+		segment = (segment + 1) % num_segments;
+
+		GLsync& f = fences[segment];
+		if (f) {
+			GLenum result = glClientWaitSync(f, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				stalls++;
+				while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+			}
+			glDeleteSync(f);
+			f = nullptr;
+		}
+
+		return mapped + offset();
+	}
+
+	void StreamBuffer::fence() {
+		GLsync& f = fences[segment];
+		if (f)
+			glDeleteSync(f);
+		f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	void StreamBuffer::destroy() {
+		for (GLsync& f : fences) {
+			if (f)
+				glDeleteSync(f);
+			f = nullptr;
+		}
+
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		glDeleteBuffers(1, &buffer);
+		mapped = nullptr;
+	}
+}
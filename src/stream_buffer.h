@@ -0,0 +1,38 @@
+#pragma once
+
+#include <GL\glew.h>
+#include <vector>
+
+namespace utils {
+	// Persistently mapped buffer split into segments that the CPU writes in
+	// turn while the GPU reads earlier ones. A fence per segment stops the CPU
+	// overwriting data still in flight; no glBufferSubData copies or implicit
+	// driver syncs are involved.
+	class StreamBuffer {
+	public:
+		StreamBuffer(GLenum target, GLsizeiptr segment_size, int num_segments = 3);
+
+		// Advance to the next segment, waiting for the GPU if it still reads it
+		void* map_next();
+
+		// Fence the current segment once the draws reading it are submitted
+		void fence();
+
+		void destroy();
+
+		GLintptr offset() const { return (GLintptr)segment * segment_size; }
+
+		GLuint buffer;
+		GLenum target;
+		GLsizeiptr segment_size;
+		int num_segments;
+		int segment;
+
+		// Times map_next() found its segment still in use and had to block
+		unsigned int stalls;
+
+	private:
+		char* mapped;
+		std::vector<GLsync> fences;
+	};
+}
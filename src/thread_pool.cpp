@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+namespace utils {
+	ThreadPool::ThreadPool(int num_threads) : queued(0), pending(0), next_queue(0), stopping(false) {
+		if (num_threads <= 0)
+			num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+		for (int i = 0; i < num_threads; i++)
+			queues.emplace_back(new Queue);
+
+		for (int i = 0; i < num_threads; i++)
+			threads.emplace_back(&ThreadPool::run, this, i);
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			stopping = true;
+		}
+		work_available.notify_all();
+
+		for (std::thread& t : threads)
+			t.join();
+	}
+
+	void ThreadPool::submit(std::function<void()> task) {
+		pending++;
+
+		Queue& q = *queues[next_queue++ % queues.size()];
+		{
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(state_mutex);
+			queued++;
+		}
+		work_available.notify_one();
+	}
+
+	void ThreadPool::wait() {
+		std::unique_lock<std::mutex> lock(state_mutex);
+		all_done.wait(lock, [this] { return pending == 0; });
+	}
+
+	bool ThreadPool::pop(int index, std::function<void()>& task) {
+		Queue& q = *queues[index];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.tasks.empty())
+			return false;
+
+		task = std::move(q.tasks.back());
+		q.tasks.pop_back();
+		return true;
+	}
+
+	bool ThreadPool::steal(int index, std::function<void()>& task) {
+		const int n = (int)queues.size();
+		for (int i = 1; i < n; i++) {
+			Queue& q = *queues[(index + i) % n];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.tasks.empty())
+				continue;
+
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	void ThreadPool::run(int index) {
+		std::function<void()> task;
+
+		while (true) {
+			if (pop(index, task) || steal(index, task)) {
+				queued--;
+				task();
+				task = nullptr;
+
+				if (--pending == 0) {
+					std::lock_guard<std::mutex> lock(state_mutex);
+					all_done.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(state_mutex);
+			work_available.wait(lock, [this] { return stopping || queued > 0; });
+			if (stopping && queued == 0)
+				return;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+	// Fixed set of worker threads, each with its own task deque. Workers take
+	// from the back of their own deque and steal from the front of the others
+	// when it runs dry, so uneven tasks spread across all cores.
+	class ThreadPool {
+	public:
+		// 0 threads means one per hardware thread
+		explicit ThreadPool(int num_threads = 0);
+		~ThreadPool();
+
+		void submit(std::function<void()> task);
+
+		// Block until every submitted task has finished
+		void wait();
+
+		int size() const { return (int)threads.size(); }
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		void run(int index);
+		bool pop(int index, std::function<void()>& task);
+		bool steal(int index, std::function<void()>& task);
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+
+		std::atomic<int> queued;
+		std::atomic<int> pending;
+		std::atomic<unsigned int> next_queue;
+		bool stopping;
+
+		std::mutex state_mutex;
+		std::condition_variable work_available;
+		std::condition_variable all_done;
+	};
+}
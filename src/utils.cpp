@@ -39,7 +39,7 @@ namespace utils {
 			{ 0.5f,  0.5f, 1.f, 1.f }
 		};
 
-		extern float triangle_points_textured[15]{
+		float triangle_points_textured[15]{
 			-1.f, 1.f, 0.f, 0.f, 0.f,
 			0.f, -1.f, 0.f, 0.5f, 1.f,
 			1.f, 1.f, 0.f, 1.f, 0.f
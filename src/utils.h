@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <random>
 #include <fstream>
 
+#include "frame_arena.h"
 #include "maths.h"
 
 namespace utils {
@@ -49,15 +52,15 @@ namespace utils {
 
 		file.seekg(16, std::ios_base::cur);
 
-		__int32 width;
-		__int32 height;
-
-		file.read((char*)&width, 4);
-		file.read((char*)&height, 4);
+		// IHDR width and height are big-endian
+		unsigned char bytes[8] = {};
+		file.read((char*)bytes, 8);
 
 		file.close();
 
-		return{ (int)_byteswap_ulong(width), (int)_byteswap_ulong(height) };
+		int width = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+		int height = (bytes[4] << 24) | (bytes[5] << 16) | (bytes[6] << 8) | bytes[7];
+		return{ width, height };
 	}
 
 	static float elapsed_time() {
@@ -85,6 +88,13 @@ namespace utils {
 		return str;
 	}
 
+	// As above without the heap, for per-frame overlays: the string lives in the arena until it resets
+	static frame_string friendly_float(FrameArena& arena, const float f, int num_digits) {
+		char digits[64];
+		int n = snprintf(digits, sizeof(digits), "%f", f);
+		return frame_string(digits, (size_t)std::max(0, std::min(num_digits, n)), ArenaAllocator<char>(arena));
+	}
+
 	static std::string friendly_float(const int i, int num_digits) {
 		std::string str = std::to_string(i);
 		if (i < 10) str = "0" + str;
@@ -92,32 +102,19 @@ namespace utils {
 	}
 
 	static mat4 gen_model_matrix(const vec2& size, const vec2& position) {
-		mat4 s = scale(vec3{size, 0.f});
-		mat4 t = transpose(translate(vec3{position, 0.f}));
-		return mult(s, t);
+		return scale_translate(vec3{size, 0.f}, vec3{position, 0.f});
 	}
 
 	static mat4 gen_model_matrix(const vec3& size, const vec3& position, float rotation) {
-		mat4 s = scale(size);
-		mat4 t = transpose(translate(position));
-		mat4 r = rotate_y(rotation);
-		return mult(mult(s, r), t);
+		return scale_rotate_translate(size, vec3{0.f, rotation, 0.f}, position);
 	}
 
 	static mat4 gen_model_matrix(const vec3& size, const vec3& position, const vec3& rotation) {
-		mat4 s = scale(size);
-		mat4 t = transpose(translate(position));
-		mat4 r = rotate(rotation);
-		
-		return mult(mult(s, r), t);
+		return scale_rotate_translate(size, rotation, position);
 	}
 
 	static mat4 gen_model_matrix(const Transform& transform) {
-		mat4 s = scale(transform.size);
-		mat4 t = transpose(translate(transform.position));
-		mat4 r = rotate(transform.rotation);
-
-		return mult(mult(s, r), t);
+		return scale_rotate_translate(transform.size, transform.rotation, transform.position);
 	}
 
 	namespace config {
@@ -0,0 +1,152 @@
+#include "wav_decoder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace dsp {
+	static uint16_t read_u16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+	static uint32_t read_u32(const unsigned char* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+	// out[f * channels + c] = sample(frame f, channel c), frames are block_align bytes apart
+	template <typename Convert>
+	static void convert(const unsigned char* src, int block_align, int bytes, int frames, int channels, float* out, Convert sample) {
+		for (int f = 0; f < frames; f++, src += block_align)
+			for (int c = 0; c < channels; c++)
+				*out++ = sample(src + c * bytes);
+	}
+
+	static const uint16_t format_pcm = 0x0001;
+	static const uint16_t format_float = 0x0003;
+	static const uint16_t format_extensible = 0xFFFE;
+
+	std::unique_ptr<Decoder> WavDecoder::open(const std::shared_ptr<utils::MappedFile>& file) {
+		const unsigned char* data = file->data;
+		const size_t size = file->size;
+
+		if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+			return nullptr;
+
+		const unsigned char* fmt = nullptr;
+		size_t fmt_size = 0;
+		const unsigned char* pcm = nullptr;
+		size_t pcm_size = 0;
+
+		// Walk the chunk list; chunks are padded to even sizes
+		size_t offset = 12;
+		while (offset + 8 <= size && !pcm) {
+			const unsigned char* chunk = data + offset;
+			size_t chunk_size = read_u32(chunk + 4);
+			size_t available = size - (offset + 8);
+
+			if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && chunk_size <= available) {
+				fmt = chunk + 8;
+				fmt_size = chunk_size;
+			}
+			else if (memcmp(chunk, "data", 4) == 0) {
+				// Writers that never patched the header leave 0 or 0xFFFFFFFF, so trust the file length
+				pcm = chunk + 8;
+				pcm_size = (chunk_size == 0 || chunk_size > available) ? available : chunk_size;
+			}
+
+			offset += 8 + chunk_size + (chunk_size & 1);
+		}
+
+		if (!fmt || !pcm)
+			return nullptr;
+
+		uint16_t tag = read_u16(fmt);
+		int channels = read_u16(fmt + 2);
+		int sample_rate = (int)read_u32(fmt + 4);
+		int block_align = read_u16(fmt + 12);
+		int bits = read_u16(fmt + 14);
+
+		// The real format tag is the first two bytes of the sub-format GUID, which
+		// needs the full 40 byte extensible chunk; shorter ones are rejected below
+		if (tag == format_extensible && fmt_size >= 40 && read_u16(fmt + 16) >= 22)
+			tag = read_u16(fmt + 24);
+
+		Encoding encoding;
+		if (tag == format_pcm && bits == 8)
+			encoding = Encoding::pcm_u8;
+		else if (tag == format_pcm && bits == 16)
+			encoding = Encoding::pcm_s16;
+		else if (tag == format_pcm && bits == 24)
+			encoding = Encoding::pcm_s24;
+		else if (tag == format_pcm && bits == 32)
+			encoding = Encoding::pcm_s32;
+		else if (tag == format_float && bits == 32)
+			encoding = Encoding::float32;
+		else if (tag == format_float && bits == 64)
+			encoding = Encoding::float64;
+		else
+			return nullptr;
+
+		if (channels <= 0 || sample_rate <= 0 || block_align < channels * (bits / 8))
+			return nullptr;
+
+		std::unique_ptr<WavDecoder> decoder{ new WavDecoder(file, pcm, encoding, block_align) };
+		decoder->sample_rate = sample_rate;
+		decoder->channels = channels;
+		decoder->length = (long long)(pcm_size / block_align);
+		return std::move(decoder);
+	}
+
+	WavDecoder::WavDecoder(const std::shared_ptr<utils::MappedFile>& file, const unsigned char* pcm, Encoding encoding, int block_align) :
+		file(file),
+		pcm(pcm),
+		encoding(encoding),
+		block_align(block_align),
+		position(0)
+	{
+	}
+
+	int WavDecoder::read(float* out, int frames) {
+		frames = (int)std::min<long long>(frames, length - position);
+		if (frames <= 0)
+			return 0;
+
+		const unsigned char* src = pcm + position * block_align;
+
+		// Switch once per chunk, the conversion inlines into each sample loop
+		switch (encoding) {
+		case Encoding::pcm_u8:
+			convert(src, block_align, 1, frames, channels, out, [](const unsigned char* s) {
+				return ((float)s[0] - 128.f) * (1.f / 128.f);
+			});
+			break;
+		case Encoding::pcm_s16:
+			convert(src, block_align, 2, frames, channels, out, [](const unsigned char* s) {
+				return (float)(int16_t)read_u16(s) * (1.f / 32768.f);
+			});
+			break;
+		case Encoding::pcm_s24:
+			convert(src, block_align, 3, frames, channels, out, [](const unsigned char* s) {
+				return (float)((int32_t)((uint32_t)s[0] << 8 | (uint32_t)s[1] << 16 | (uint32_t)s[2] << 24) >> 8) * (1.f / 8388608.f);
+			});
+			break;
+		case Encoding::pcm_s32:
+			convert(src, block_align, 4, frames, channels, out, [](const unsigned char* s) {
+				return (float)(int32_t)read_u32(s) * (1.f / 2147483648.f);
+			});
+			break;
+		case Encoding::float32:
+			convert(src, block_align, 4, frames, channels, out, [](const unsigned char* s) {
+				float v;
+				memcpy(&v, s, 4);
+				return v;
+			});
+			break;
+		case Encoding::float64:
+			convert(src, block_align, 8, frames, channels, out, [](const unsigned char* s) {
+				double v;
+				memcpy(&v, s, 8);
+				return (float)v;
+			});
+			break;
+		}
+
+		position += frames;
+		return frames;
+	}
+}
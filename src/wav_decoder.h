@@ -0,0 +1,25 @@
+#pragma once
+
+#include "decoder.h"
+
+namespace dsp {
+	// RIFF/WAVE reader working straight off the mapped file: 8/16/24/32-bit
+	// integer PCM and 32/64-bit float, plain or WAVE_FORMAT_EXTENSIBLE.
+	class WavDecoder : public Decoder {
+	public:
+		static std::unique_ptr<Decoder> open(const std::shared_ptr<utils::MappedFile>& file);
+
+		int read(float* out, int frames) override;
+
+	private:
+		enum class Encoding { pcm_u8, pcm_s16, pcm_s24, pcm_s32, float32, float64 };
+
+		WavDecoder(const std::shared_ptr<utils::MappedFile>& file, const unsigned char* pcm, Encoding encoding, int block_align);
+
+		std::shared_ptr<utils::MappedFile> file;
+		const unsigned char* pcm;
+		Encoding encoding;
+		int block_align;
+		long long position;
+	};
+}